@@ -0,0 +1,40 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "Config.h"
+
+#include <cstdio>
+#include <cfloat>
+#include <algorithm>
+
+//best of several runs in milliseconds, one-off stalls shouldn't count against the code being measured
+template<typename F>
+inline double bench_ms(int32_t runs, F&& body)
+{
+    double best = DBL_MAX;
+    for (int32_t i = 0; i < runs; i++)
+    {
+        auto start = Clock::now();
+        body();
+        best = min(best, chrono::duration<double, milli>(Clock::now() - start).count());
+    }
+
+    return best;
+}
+
+//keeps results alive so the optimizer can't drop the work
+inline void bench_sink(const void* data, size_t size)
+{
+    static volatile uint8_t sink;
+    if (size > 0)
+        sink = ((const uint8_t*)data)[size - 1];
+}
+
+//deterministic so runs are comparable between builds
+inline float bench_random(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "Bench.h"
+#include "Window.h"
+#include "Canvas.h"
+#include "Path.h"
+
+#include <cmath>
+
+static const uint32_t WIDTH = 1920;
+static const uint32_t HEIGHT = 1080;
+static const int32_t FRAMES = 200;
+
+//translucent shapes covering the window several times over, every pixel pays for its fringe and samples
+static void draw_scene(Canvas& canvas, PathPtr blob)
+{
+    auto state = canvas.get_state();
+    uint32_t seed = 7;
+    for (int32_t i = 0; i < 400; i++)
+    {
+        float x = bench_random(seed) * WIDTH;
+        float y = bench_random(seed) * HEIGHT;
+        float size = 40.0f + bench_random(seed) * 160.0f;
+
+        state->push_color(Color(bench_random(seed), bench_random(seed), bench_random(seed), 0.5f));
+        if (i % 2 == 0)
+            canvas.draw_circle(x, y, size);
+        else
+            canvas.draw_rounded_rect(x - size, y - size * 0.5f, size * 2.0f, size, size * 0.25f);
+        state->pop_color();
+    }
+
+    for (int32_t i = 0; i < 20; i++)
+    {
+        state->push_matrix(glm::translate(fmatrix4(1.0f), fvec3(bench_random(seed) * WIDTH, bench_random(seed) * HEIGHT, 0.0f)));
+        state->push_color(Color(1.0f, 1.0f, 1.0f, 0.25f));
+        canvas.fill_path(blob);
+        state->pop_color();
+        state->pop_matrix();
+    }
+}
+
+//average frame time with the gpu drained after every frame, vsync off
+static double measure(const char* name, int32_t samples, bool antialiasing, PathPtr blob)
+{
+    Window window;
+    if (!window.open(name, WIDTH, HEIGHT, false, samples))
+        return -1.0;
+
+    SDL_GL_SetSwapInterval(0);
+
+    double total = 0.0;
+    {
+        Canvas canvas;
+        canvas.set_viewport(0.0f, 0.0f, window.get_viewport_width(), window.get_viewport_height());
+        canvas.set_antialiasing(antialiasing);
+
+        for (int32_t frame = -10; frame < FRAMES; frame++)
+        {
+            window.event_tick();
+
+            auto ms = bench_ms(1, [&]()
+            {
+                canvas.begin();
+                draw_scene(canvas, blob);
+                canvas.end();
+                glFinish();
+            });
+
+            window.swap();
+
+            //the first frames compile shaders and grow buffers
+            if (frame >= 0)
+                total += ms;
+        }
+    }
+
+    window.close();
+    return total / FRAMES;
+}
+
+int main()
+{
+    auto blob = NEW_0(Path);
+    blob->move_to(0.0f, -150.0f);
+    for (int32_t i = 1; i < 64; i++)
+    {
+        float angle = 6.2831853f * i / 64;
+        float radius = i % 2 == 0 ? 150.0f : 90.0f;
+        blob->line_to(sinf(angle) * radius, -cosf(angle) * radius);
+    }
+    blob->close();
+
+    struct Mode
+    {
+        const char* name;
+        int32_t samples;
+        bool antialiasing;
+    };
+
+    const Mode modes[] = { { "aliased", 0, false }, { "fringe", 0, true }, { "msaa 4x", 4, false }, { "msaa 8x", 8, false } };
+
+    printf("%10s %12s %12s\n", "mode", "frame ms", "vs aliased");
+
+    double aliased = 0.0;
+    for (auto& mode : modes)
+    {
+        auto ms = measure(mode.name, mode.samples, mode.antialiasing, blob);
+        if (ms < 0.0)
+        {
+            printf("%10s %12s\n", mode.name, "unavailable");
+            continue;
+        }
+
+        if (mode.samples == 0 && !mode.antialiasing)
+            aliased = ms;
+
+        printf("%10s %12.3f %11.2fx\n", mode.name, ms, aliased > 0.0 ? ms / aliased : 0.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "Bench.h"
+#include "Polyline.h"
+#include "VertexKernel.h"
+
+#include <new>
+#include <cmath>
+
+//every heap allocation made by the process, read around the code being measured
+static size_t s_allocations = 0;
+
+void* operator new(size_t size)
+{
+    s_allocations++;
+    if (void* data = malloc(size > 0 ? size : 1))
+        return data;
+
+    throw bad_alloc();
+}
+
+void operator delete(void* data) noexcept
+{
+    free(data);
+}
+
+void operator delete(void* data, size_t) noexcept
+{
+    free(data);
+}
+
+//The tessellator draw_polyline used before the streaming one, kept to compare
+//against: points copied by value, one anchor vector per joint and the geometry
+//returned by value. Its 16-bit indices wrap past 8k joints, which doesn't change its cost
+using GeometryData = pair<vector<VertexData>, vector<uint16_t>>;
+
+static void intersect(fvec2 P1, fvec2 P2, fvec2 P3, fvec2 P4, fvec2& Pout)
+{
+    float eps = 0.000000000001f;
+    float denom = (P4.y - P3.y) * (P2.x - P1.x) - (P4.x - P3.x) * (P2.y - P1.y);
+    float numera = (P4.x - P3.x) * (P1.y - P3.y) - (P4.y - P3.y) * (P1.x - P3.x);
+    float numerb = (P2.x - P1.x) * (P1.y - P3.y) - (P2.y - P1.y) * (P1.x - P3.x);
+
+    if ((-eps < numera && numera < eps) && (-eps < numerb && numerb < eps) && (-eps < denom && denom < eps))
+    {
+        Pout = (P1 + P2) * 0.5f;
+        return;
+    }
+
+    if (-eps < denom && denom < eps)
+    {
+        Pout = fvec2();
+        return;
+    }
+
+    float mua = numera / denom;
+    Pout.x = P1.x + mua * (P2.x - P1.x);
+    Pout.y = P1.y + mua * (P2.y - P1.y);
+}
+
+static GeometryData polyline_reference(vector<fvec2> points, float strength)
+{
+    vector<fvec2> midPoints;
+    vector<vector<fvec2>> anchors;
+
+    for (size_t i = 0; i < points.size() - 1; i++)
+        midPoints.emplace_back((points[i] + points[i + 1]) * 0.5f);
+
+    midPoints[0] = points[0];
+    midPoints[points.size() - 2] = points[points.size() - 1];
+
+    for (size_t i = 1; i < points.size() - 2; i++)
+        anchors.push_back({ midPoints[i - 1], points[i], midPoints[i] });
+
+    vector<VertexData> vertices;
+    vector<uint16_t> indices;
+
+    for (auto& anchor : anchors)
+    {
+        auto n0 = fvec2(-(anchor[1].y - anchor[0].y), anchor[1].x - anchor[0].x);
+        auto n2 = fvec2(-(anchor[2].y - anchor[1].y), anchor[2].x - anchor[1].x);
+        n0 = n0 * (1.0f / sqrtf(n0.x * n0.x + n0.y * n0.y));
+        n2 = n2 * (1.0f / sqrtf(n2.x * n2.x + n2.y * n2.y));
+
+        fvec2 t0 = anchor[0] - n0 * strength;
+        fvec2 mint0 = anchor[0] + n0 * strength;
+        fvec2 t2 = anchor[2] - n2 * strength;
+        fvec2 mint2 = anchor[2] + n2 * strength;
+        fvec2 at = anchor[1] - n0 * strength;
+        fvec2 bt = anchor[1] - n2 * strength;
+
+        fvec2 vp;
+        intersect(t0, at, t2, bt, vp);
+        fvec2 minvp = anchor[1] - (vp - anchor[1]);
+
+        auto base = (uint16_t)vertices.size();
+        for (auto& point : { t0, mint0, t2, mint2, at, bt, vp, minvp })
+            vertices.emplace_back(point, fvec2(), 0xFFFFFFFF);
+
+        static const uint16_t PIECE[] = { 0, 4, 7, 0, 7, 1, 4, 6, 5, 4, 5, 7, 5, 2, 7, 2, 3, 7 };
+        for (auto index : PIECE)
+            indices.push_back(base + index);
+    }
+
+    return { vertices, indices };
+}
+
+//what Canvas::tessellate_polyline does up to handing the range to a layer
+static void polyline_streaming(const vector<fvec2>& points, float strength, const VertexTransform& transform, VertexArena& vertex_arena, IndexArena& index_arena)
+{
+    auto pieces = polyline_pieces(points.size(), false);
+    auto vertex_count = polyline_vertices(points.size(), pieces);
+    auto index_count = polyline_indices(points.size(), pieces);
+
+    auto vertex_start = vertex_arena.allocate(vertex_count);
+    auto index_start = index_arena.allocate(index_count);
+    auto* vertices = vertex_arena.data(vertex_start);
+
+    polyline(points.data(), points.size(), false, strength, 0, pieces, vertices, index_arena.data(index_start));
+    transform_vertices(transform, vertices, vertices, vertex_count);
+}
+
+int main()
+{
+    static const size_t SIZES[] = { 16, 1024, 8192, 500000 };
+    static const int32_t FRAMES = 5;
+
+    printf("%10s %16s %16s %16s %16s\n", "points", "reference allocs", "streaming allocs", "reference us", "streaming us");
+
+    for (auto size : SIZES)
+    {
+        //a line chart, one point per x step
+        vector<fvec2> points(size);
+        uint32_t seed = 7;
+        for (size_t i = 0; i < size; i++)
+            points[i] = fvec2(i * 0.5f, 300.0f + 200.0f * sinf(i * 0.01f) + bench_random(seed) * 20.0f);
+
+        VertexTransform transform;
+        VertexArena vertex_arena;
+        IndexArena index_arena;
+
+        //the arenas only grow while warming up, like the first frames of a canvas
+        polyline_streaming(points, 1.0f, transform, vertex_arena, index_arena);
+        vertex_arena.reset();
+        index_arena.reset();
+
+        size_t reference_allocations = 0;
+        auto reference = bench_ms(FRAMES, [&]()
+        {
+            auto before = s_allocations;
+            auto data = polyline_reference(points, 1.0f);
+            reference_allocations = s_allocations - before;
+            bench_sink(data.first.data(), data.first.size() * sizeof(VertexData));
+        });
+
+        size_t streaming_allocations = 0;
+        auto streaming = bench_ms(FRAMES, [&]()
+        {
+            auto before = s_allocations;
+            polyline_streaming(points, 1.0f, transform, vertex_arena, index_arena);
+            streaming_allocations = s_allocations - before;
+            bench_sink(vertex_arena.data(0), vertex_arena.size() * sizeof(VertexData));
+
+            vertex_arena.reset();
+            index_arena.reset();
+        });
+
+        printf("%10zu %16zu %16zu %16.1f %16.1f\n", size, reference_allocations, streaming_allocations, reference * 1000.0, streaming * 1000.0);
+    }
+
+    return 0;
+}
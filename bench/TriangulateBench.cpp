@@ -0,0 +1,102 @@
+#include "Bench.h"
+#include "Triangulate.h"
+
+#include <cmath>
+
+static const float PI = 3.14159265f;
+
+//convex, the fan Path::build keeps after polygon_convex
+static void make_circle(size_t count, vector<fvec2>& points)
+{
+    points.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        float angle = 2.0f * PI * i / count;
+        points[i] = fvec2(cosf(angle), sinf(angle)) * 500.0f;
+    }
+}
+
+//simple but concave everywhere, like a filled chart outline traced from data
+static void make_noisy(size_t count, vector<fvec2>& points)
+{
+    uint32_t state = 1;
+    points.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        float angle = 2.0f * PI * i / count;
+        points[i] = fvec2(cosf(angle), sinf(angle)) * (400.0f + 100.0f * bench_random(state));
+    }
+}
+
+//alternating deep spikes, every other vertex is a reflex one
+static void make_star(size_t count, vector<fvec2>& points)
+{
+    points.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        float angle = 2.0f * PI * i / count;
+        points[i] = fvec2(cosf(angle), sinf(angle)) * (i % 2 == 0 ? 500.0f : 100.0f);
+    }
+}
+
+//long thin teeth along one side, ears are only found at the tips
+static void make_comb(size_t count, vector<fvec2>& points)
+{
+    size_t teeth = max<size_t>(1, (count - 2) / 4);
+
+    points.clear();
+    points.emplace_back(0.0f, 0.0f);
+    for (size_t i = 0; i < teeth; i++)
+    {
+        float x = (float)i * 4.0f;
+        points.emplace_back(x, 100.0f);
+        points.emplace_back(x + 1.0f, 100.0f);
+        points.emplace_back(x + 1.0f, 10.0f);
+        points.emplace_back(x + 4.0f, 10.0f);
+    }
+    points.emplace_back(teeth * 4.0f, 0.0f);
+}
+
+int main()
+{
+    struct Shape
+    {
+        const char* name;
+        void (*make)(size_t, vector<fvec2>&);
+    };
+
+    const Shape shapes[] = { { "circle", make_circle }, { "noisy", make_noisy }, { "star", make_star }, { "comb", make_comb } };
+    const size_t sizes[] = { 10, 100, 1000, 4000, 10000, 100000 };
+
+    printf("%8s %10s %12s %12s %12s %10s\n", "shape", "vertices", "convex ms", "simple ms", "ear clip ms", "triangles");
+
+    vector<fvec2> points;
+    vector<uint32_t> indices;
+    for (auto& shape : shapes)
+    {
+        for (auto size : sizes)
+        {
+            shape.make(size, points);
+            auto count = points.size();
+            auto runs = count > 10000 ? 3 : 20;
+
+            bool convex = false;
+            bool simple = false;
+            bool clipped = false;
+
+            auto convex_ms = bench_ms(runs, [&]() { convex = polygon_convex(points.data(), count); });
+            auto simple_ms = bench_ms(runs, [&]() { simple = polygon_simple(points.data(), count); });
+            auto clip_ms = bench_ms(runs, [&]()
+            {
+                indices.clear();
+                clipped = triangulate(points.data(), count, 0, indices);
+            });
+
+            bench_sink(indices.data(), indices.size() * sizeof(uint32_t));
+            printf("%8s %10zu %12.3f %12.3f %12.3f %10zu%s\n", shape.name, count, convex_ms, simple_ms, clip_ms,
+                indices.size() / 3, convex ? " convex" : (!simple ? " not simple" : (!clipped ? " failed" : "")));
+        }
+    }
+
+    return 0;
+}
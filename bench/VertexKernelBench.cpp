@@ -0,0 +1,84 @@
+#include "Bench.h"
+#include "VertexKernel.h"
+#include "Color.h"
+
+//The loop RenderLayer::draw ran before the kernel: Color temporaries for every
+//vertex and the flip applied after the transform
+static void transform_reference(const fmatrix4& matrix, const Color& color, float opacity, bool flipped_y, float viewport_height,
+    const VertexData* source, VertexData* target, size_t count)
+{
+    float _00 = matrix[0][0];
+    float _01 = matrix[0][1];
+    float _10 = matrix[1][0];
+    float _11 = matrix[1][1];
+    float _30 = matrix[3][0];
+    float _31 = matrix[3][1];
+
+    auto modulate = color;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& vert = source[i];
+        auto& out = target[i];
+
+        out.v.x = _00 * vert.v.x + _10 * vert.v.y + _30;
+        out.v.y = _01 * vert.v.x + _11 * vert.v.y + _31;
+        out.uv.x = vert.uv.x;
+        out.uv.y = vert.uv.y;
+        out.color = (modulate * vert.color * opacity).uint;
+
+        if (flipped_y)
+            out.v.y = viewport_height - out.v.y;
+    }
+}
+
+int main()
+{
+    static const size_t SIZES[] = { 64, 4096, 65536, 1 << 20 };
+
+    //rotated, scaled and translated so none of the terms drop out
+    fmatrix4 matrix;
+    matrix[0][0] = 1.2f; matrix[0][1] = 0.3f;
+    matrix[1][0] = -0.3f; matrix[1][1] = 1.2f;
+    matrix[3][0] = 120.0f; matrix[3][1] = 80.0f;
+    Color color(0.9f, 0.6f, 0.3f, 0.8f);
+    float opacity = 0.75f;
+
+    printf("%10s %14s %14s %10s %10s\n", "vertices", "scalar us", "kernel us", "Mvert/s", "speedup");
+
+    for (auto size : SIZES)
+    {
+        vector<VertexData> source(size);
+        vector<VertexData> target(size);
+
+        uint32_t seed = 1;
+        for (auto& vertex : source)
+        {
+            vertex.v = fvec2(bench_random(seed) * 1920.0f, bench_random(seed) * 1080.0f);
+            vertex.uv = fvec2(bench_random(seed), bench_random(seed));
+            vertex.color = (uint32_t)(bench_random(seed) * 4294967295.0f);
+        }
+
+        //enough repetitions that every size runs for a few milliseconds
+        auto repeat = max((size_t)1, (size_t)(1 << 22) / size);
+        VertexTransform transform(matrix, fvec4(0.0f, 0.0f, 1.0f, 1.0f), (Color(color) * opacity).uint, 0, true, 1080.0f);
+
+        auto reference = bench_ms(5, [&]()
+        {
+            for (size_t i = 0; i < repeat; i++)
+                transform_reference(matrix, color, opacity, true, 1080.0f, source.data(), target.data(), size);
+            bench_sink(target.data(), target.size() * sizeof(VertexData));
+        });
+
+        auto kernel = bench_ms(5, [&]()
+        {
+            for (size_t i = 0; i < repeat; i++)
+                transform_vertices(transform, source.data(), target.data(), size);
+            bench_sink(target.data(), target.size() * sizeof(VertexData));
+        });
+
+        printf("%10zu %14.2f %14.2f %10.1f %9.2fx\n", size, reference * 1000.0 / repeat, kernel * 1000.0 / repeat,
+            size * repeat / (kernel * 1000.0), reference / kernel);
+    }
+
+    return 0;
+}
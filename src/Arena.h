@@ -0,0 +1,80 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include "Config.h"
+
+//Per-frame bump allocator. Allocations are handed out as offsets so they stay
+//valid when the backing storage grows, the storage is never zero-filled and it
+//is released again once the peak usage stays well below the capacity.
+template<typename T>
+class Arena
+{
+private:
+    static const size_t MIN_CAPACITY = 4096;
+    static const int32_t SHRINK_FRAMES = 120;
+
+    UPTR(uint8_t[]) m_data;
+    size_t m_size;
+    size_t m_capacity;
+    size_t m_peak;
+    int32_t m_frames;
+public:
+    Arena() :
+        m_data(), m_size(0), m_capacity(0), m_peak(0), m_frames(0)
+    {
+    }
+
+    size_t allocate(size_t count)
+    {
+        size_t offset = m_size;
+
+        if (m_size + count > m_capacity)
+            reserve(max(m_size + count, max(m_capacity * 2, MIN_CAPACITY)));
+
+        m_size += count;
+        return offset;
+    }
+
+    void reset()
+    {
+        m_peak = max(m_peak, m_size);
+        m_size = 0;
+
+        if (++m_frames < SHRINK_FRAMES)
+            return;
+
+        if (m_peak * 4 < m_capacity)
+            reserve(max(m_peak * 2, MIN_CAPACITY));
+
+        m_peak = 0;
+        m_frames = 0;
+    }
+
+    inline T* data(size_t offset)
+    {
+        return reinterpret_cast<T*>(m_data.get()) + offset;
+    }
+
+    inline size_t size()
+    {
+        return m_size;
+    }
+
+    inline size_t capacity()
+    {
+        return m_capacity;
+    }
+private:
+    void reserve(size_t capacity)
+    {
+        UPTR(uint8_t[]) data(new uint8_t[capacity * sizeof(T)]);
+
+        if (m_size > 0)
+            memcpy(data.get(), m_data.get(), m_size * sizeof(T));
+
+        m_data = move(data);
+        m_capacity = capacity;
+    }
+};
+
+#endif
@@ -1,194 +1,40 @@
 ﻿#include "Canvas.h"
 #include "LogSystem.h"
 #include "RenderLayer.h"
+#include "StreamBuffer.h"
+#include "TextureAtlas.h"
+#include "Polyline.h"
+#include "CommandRecorder.h"
+#include "VertexKernel.h"
+#include "StaticMesh.h"
+#include "DamageTracker.h"
+#include "Hash.h"
+#include "GLState.h"
+#include "UniformBuffer.h"
+#include "LineSeries.h"
+#include "Path.h"
+#include "ShapeCache.h"
+#include "Feather.h"
+#include "Triangulate.h"
+#include "GlyphAtlas.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <png.h>
+#include <algorithm>
+#include <cfloat>
 
-using GeometryData = pair<vector<VertexData>, vector<uint16_t>>;
-static int32_t intersect(fvec2 P1, fvec2 P2, fvec2 P3, fvec2 P4, fvec2& Pout)
-{
-    float mua = 0.0f;
-    float mub = 0.0f;
-    float denom = 0.0f;
-    float numera = 0.0f;
-    float numerb = 0.0f;
-    float eps = 0.000000000001f;
-
-    denom = (P4.y - P3.y) * (P2.x - P1.x) - (P4.x - P3.x) * (P2.y - P1.y);
-    numera = (P4.x - P3.x) * (P1.y - P3.y) - (P4.y - P3.y) * (P1.x - P3.x);
-    numerb = (P2.x - P1.x) * (P1.y - P3.y) - (P2.y - P1.y) * (P1.x - P3.x);
-    if ((-eps < numera && numera < eps) && (-eps < numerb && numerb < eps) && (-eps < denom  && denom  < eps))
-    {
-        Pout.x = (P1.x + P2.x) * 0.5f;
-        Pout.y = (P1.y + P2.y) * 0.5f;
-        return 2; //meaning the lines coincide
-    }
-    if (-eps < denom  && denom  < eps)
-    {
-        Pout.x = 0;
-        Pout.y = 0;
-        return 0; //meaning lines are parallel
-    }
-    mua = numera / denom;
-    mub = numerb / denom;
-    Pout.x = P1.x + mua * (P2.x - P1.x);
-    Pout.y = P1.y + mua * (P2.y - P1.y);
-    bool out1 = mua < 0 || mua > 1;
-    bool out2 = mub < 0 || mub > 1;
-
-    if (out1 && out2)
-    {
-        return 5; //the intersection lies outside both segments
-    }
-    else if (out1)
-    {
-        return 3; //the intersection lies outside segment 1
-    }
-    else if (out2)
-    {
-        return 4; //the intersection lies outside segment 2
-    }
-    else
-    {
-        return 1; //the intersection lies inside both segments
-    }
-}
-
-static GeometryData polyline(vector<fvec2> points, bool closed = false, float strength = 0.6f)
-{
-    if (points.size() <= 1)
-        return { vector<VertexData>(), vector<uint16_t>() };
-
-    if (points.size() == 2)
-    {
-        vector<fvec2> midPoints = {
-            fvec2(points[0].x, points[0].y),
-            fvec2(points[1].x, points[1].y)
-        };
-
-        float nx = -(points[1].y - points[0].y);
-        float ny = points[1].x - points[0].x;
-        float length = sqrtf((nx * nx) + (ny * ny));
-        nx /= length;
-        ny /= length;
-
-        fvec2 t0(points[0].x + nx * strength, points[0].y + ny * strength);
-        fvec2 mint0(points[0].x - nx * strength, points[0].y - ny * strength);
-        fvec2 t2(points[1].x + nx * strength, points[1].y + ny * strength);
-        fvec2 mint2(points[1].x - nx * strength, points[1].y - ny * strength);
-
-        vector<VertexData> vertices;
-        vertices.push_back(VertexData(t0));		//0
-        vertices.push_back(VertexData(mint0));	//1
-        vertices.push_back(VertexData(t2));		//2
-        vertices.push_back(VertexData(mint2));	//3
-
-        vector<unsigned short> indices;
-        indices.push_back(0); indices.push_back(2); indices.push_back(3);
-        indices.push_back(3); indices.push_back(1); indices.push_back(0);
-
-        return { vertices, indices };
-    }
-
-    vector<fvec2> midPoints;
-    vector<vector<fvec2>> anchors;
-
-    if (closed)
-    {
-        for (size_t i = 0; i < points.size();i++)
-        {
-            fvec2 curr = points[i];
-            fvec2 next = points[i == points.size() - 1 ? 0 : i + 1];
-            midPoints.emplace_back(curr.x + ((next.x - curr.x) / 2.0), curr.y + ((next.y - curr.y) / 2.0));
-        }
-
-        for (size_t i = 0; i < points.size(); i++)
-        {
-            fvec2 previous = midPoints[i == 0 ? midPoints.size() - 1 : i - 1];
-            fvec2 current = points[i];
-            fvec2 next = midPoints[i];
-
-            anchors.push_back({ previous, current, next });
-        }
-    }
-    else
-    {
-        for (size_t i = 0; i < points.size() - 1; i++)
-        {
-            fvec2 curr = points[i];
-            fvec2 next = points[i + 1];
-            midPoints.emplace_back(curr.x + ((next.x - curr.x) / 2.0), curr.y + ((next.y - curr.y) / 2.0));
-        }
-
-        midPoints[0] = points[0];
-        midPoints[points.size() - 2] = points[points.size() - 1];
-
-        for (size_t i = 1; i < points.size() - 2; i++)
-        {
-            fvec2 previous = midPoints[i - 1];
-            fvec2 current = points[i];
-            fvec2 next = midPoints[i];
-
-            anchors.push_back({ previous, current, next });
-        }
-    }
-
-    vector<VertexData> vertices;
-    vector<uint16_t> indices;
-
-    for (auto& anchor : anchors)
-    {
-        float n0x = -(anchor[1].y - anchor[0].y);
-        float n0y = anchor[1].x - anchor[0].x;
-        float n2x = -(anchor[2].y - anchor[1].y);
-        float n2y = anchor[2].x - anchor[1].x;
-        float length0 = sqrtf((n0x * n0x) + (n0y * n0y));
-        float length2 = sqrtf((n2x * n2x) + (n2y * n2y));
-
-        n0x /= length0;
-        n0y /= length0;
-        n2x /= length2;
-        n2y /= length2;
-
-        fvec2 t0(anchor[0].x - n0x * strength, anchor[0].y - n0y * strength);						//0
-        fvec2 mint0(anchor[0].x + n0x * strength, anchor[0].y + n0y * strength);					//1
-        fvec2 t2(anchor[2].x - n2x * strength, anchor[2].y - n2y * strength);						//2
-        fvec2 mint2(anchor[2].x + n2x * strength, anchor[2].y + n2y * strength);					//3
-        fvec2 at(anchor[1].x - n0x * strength, anchor[1].y - n0y * strength);						//4
-        fvec2 bt(anchor[1].x - n2x * strength, anchor[1].y - n2y * strength);						//5
-
-        fvec2 vp;																					//6
-        intersect(t0, at, t2, bt, vp);
-        fvec2 minvp(anchor[1].x - (vp.x - anchor[1].x), anchor[1].y - (vp.y - anchor[1].y));		//7
-
-        uint16_t currentIndex = (uint16_t)vertices.size();
-        vertices.emplace_back(t0);
-        vertices.emplace_back(mint0);
-        vertices.emplace_back(t2);
-        vertices.emplace_back(mint2);
-        vertices.emplace_back(at);
-        vertices.emplace_back(bt);
-        vertices.emplace_back(vp);
-        vertices.emplace_back(minvp);
-
-        indices.push_back(currentIndex + 0); indices.push_back(currentIndex + 4); indices.push_back(currentIndex + 7);
-        indices.push_back(currentIndex + 0); indices.push_back(currentIndex + 7); indices.push_back(currentIndex + 1);
-
-        indices.push_back(currentIndex + 4); indices.push_back(currentIndex + 6); indices.push_back(currentIndex + 5);
-        indices.push_back(currentIndex + 4); indices.push_back(currentIndex + 5); indices.push_back(currentIndex + 7);
-
-        indices.push_back(currentIndex + 5); indices.push_back(currentIndex + 2); indices.push_back(currentIndex + 7);
-        indices.push_back(currentIndex + 2); indices.push_back(currentIndex + 3); indices.push_back(currentIndex + 7);
-    }
-
-    return { vertices, indices };
-}
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 Canvas::Canvas() : 
-    m_layers(), m_state(move(UNEW_0(RenderState))), m_setup(false), m_clear_color(0.0f, 0.0f, 0.0f, 1.0f),
+    m_layers(), m_damage(move(UNEW_0(DamageTracker))), m_damage_tracking(false), m_buffer_age(0), m_damage_rects(),
+    m_idle_detection(false), m_invalidated(true), m_replayed(false), m_frame_hash(HASH_OFFSET_BASIS), m_last_frame_hash(0),
+    m_state(move(UNEW_0(RenderState))), m_start_counter(0), m_last_counter(0), m_stats(), m_setup(false), m_clear_color(0.0f, 0.0f, 0.0f, 1.0f),
     m_viewport_x(0.0f), m_viewport_y(0.0f), m_viewport_width(1.0f), m_viewport_height(1.0f),
-    m_textures(), m_viewport_scale_x(1.0f), m_viewport_scale_y(1.0f)
+    m_textures(), m_atlas(move(UNEW_0(TextureAtlas))), m_shape_cache(move(UNEW_0(ShapeCache))), m_glyph_atlas(move(UNEW_0(GlyphAtlas))),
+    m_parallel_compile(false), m_atlas_enabled(false), m_antialiasing(true), m_viewport_scale_x(1.0f), m_viewport_scale_y(1.0f), m_scissor(false), m_depth(0),
+    m_vertex_generation(0), m_index_generation(0)
 {
 }
 
@@ -202,54 +48,104 @@ void Canvas::setup()
 
     glGenVertexArrays(1, &m_vao);
     CHECK_GL_ERROR;
-    glBindVertexArray(m_vao);
-    CHECK_GL_ERROR;
+    GLState::get()->bind_vertex_array(m_vao);
 
-    CHECK_GL_ERROR;
-    glEnable(GL_BLEND);
-    CHECK_GL_ERROR;
+    GLState::get()->set_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glBlendEquation(GL_FUNC_ADD);
     CHECK_GL_ERROR;
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    CHECK_GL_ERROR;
-    glEnable(GL_DEPTH_TEST);
-    CHECK_GL_ERROR;
+    GLState::get()->set_depth_test(true);
     glDepthFunc(GL_LEQUAL);
     CHECK_GL_ERROR;
 
+    m_parallel_compile = SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile") ? true : false;
+    if (m_parallel_compile)
+    {
+        //let the driver pick how many compiler threads to use
+        auto max_threads = (void (APIENTRY*)(GLuint))SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+        if (max_threads != nullptr)
+            max_threads(0xFFFFFFFF);
+    }
+
     string vertexSource =
         "#version 330                                               \r\n"
         "in vec4 position;                                          \r\n"
         "in vec4 color;                                             \r\n"
+        "in uint slot;                                              \r\n"
         "                                                           \r\n"
         "out vec2 vTexCoord;                                        \r\n"
         "out vec4 vColor;                                           \r\n"
+        "flat out uint vSlot;                                       \r\n"
         "                                                           \r\n"
-        "uniform mat4 projection;                                   \r\n"
+        FRAME_DATA_BLOCK
         "                                                           \r\n"
         "void main(void)                                            \r\n"
         "{                                                          \r\n"
         "    vColor = color;                                        \r\n"
         "    vTexCoord = position.zw;                                \r\n"
+        "    vSlot = slot;                                          \r\n"
         "                                                           \r\n"
         "    gl_Position = projection * vec4(position.xy, 0, 1);    \r\n"
         "}                                                          \r\n";
 
     //"precision mediump float;" +
+    //samplers can't be indexed by a varying in GLSL 330, select them with a switch instead
+    string sampleSource;
+    for (int32_t i = 0; i < RenderLayer::MAX_TEXTURE_SLOTS; i++)
+        sampleSource += "        case " + to_string(i) + "u: return texture(tex[" + to_string(i) + "], uv);\r\n";
+
     string fragmentSource =
         "#version 330                                               \r\n"
         "in vec2 vTexCoord;                                         \r\n"
         "in vec4 vColor;                                            \r\n"
+        "flat in uint vSlot;                                        \r\n"
         "out vec4 oColor;                                           \r\n"
         "                                                           \r\n"
-        "uniform sampler2D tex;                                     \r\n"
+        "uniform sampler2D tex[" + to_string(RenderLayer::MAX_TEXTURE_SLOTS) + "];\r\n"
+        "                                                           \r\n"
+        "vec4 sample_slot(vec2 uv)                                  \r\n"
+        "{                                                          \r\n"
+        "    switch (vSlot)                                         \r\n"
+        "    {                                                      \r\n"
+        + sampleSource +
+        "    }                                                      \r\n"
+        "                                                           \r\n"
+        "    return vec4(0);                                        \r\n"
+        "}                                                          \r\n"
         "                                                           \r\n"
         "void main(void)                                            \r\n"
         "{                                                          \r\n"
-        "    vec4 color = texture(tex, vTexCoord) * vColor;         \r\n"
+        "    vec4 color = sample_slot(vTexCoord) * vColor;          \r\n"
         "    oColor = color;                                        \r\n"
         "}                                                          \r\n";
 
+    //distance fields keep the edge at one half, fwidth keeps it about a pixel wide at any scale
+    string sdfFragmentSource =
+        "#version 330                                               \r\n"
+        "in vec2 vTexCoord;                                         \r\n"
+        "in vec4 vColor;                                            \r\n"
+        "flat in uint vSlot;                                        \r\n"
+        "out vec4 oColor;                                           \r\n"
+        "                                                           \r\n"
+        "uniform sampler2D tex[" + to_string(RenderLayer::MAX_TEXTURE_SLOTS) + "];\r\n"
+        "                                                           \r\n"
+        "vec4 sample_slot(vec2 uv)                                  \r\n"
+        "{                                                          \r\n"
+        "    switch (vSlot)                                         \r\n"
+        "    {                                                      \r\n"
+        + sampleSource +
+        "    }                                                      \r\n"
+        "                                                           \r\n"
+        "    return vec4(0);                                        \r\n"
+        "}                                                          \r\n"
+        "                                                           \r\n"
+        "void main(void)                                            \r\n"
+        "{                                                          \r\n"
+        "    float distance = sample_slot(vTexCoord).a;             \r\n"
+        "    float width = max(fwidth(distance), 0.0001);           \r\n"
+        "    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);\r\n"
+        "    oColor = vec4(vColor.rgb, vColor.a * alpha);           \r\n"
+        "}                                                          \r\n";
+
     string geomVertexSource =
         "#version 330                                               \r\n"
         "in vec4 position;                                          \r\n"
@@ -257,7 +153,7 @@ void Canvas::setup()
         "                                                           \r\n"
         "out vec4 vColor;                                           \r\n"
         "                                                           \r\n"
-        "uniform mat4 projection;                                   \r\n"
+        FRAME_DATA_BLOCK
         "                                                           \r\n"
         "void main(void)                                            \r\n"
         "{                                                          \r\n"
@@ -277,18 +173,201 @@ void Canvas::setup()
         "    oColor = vColor;                                       \r\n"
         "}                                                          \r\n";
 
+    //unit quad corner plus one SpriteInstance per sprite, see bind_instances for the layout
+    string spriteVertexSource =
+        "#version 330                                               \r\n"
+        "layout(location = 0) in vec2 corner;                       \r\n"
+        "layout(location = 4) in vec2 axis_x;                       \r\n"
+        "layout(location = 5) in vec2 axis_y;                       \r\n"
+        "layout(location = 6) in vec2 origin;                       \r\n"
+        "layout(location = 7) in vec4 region;                       \r\n"
+        "layout(location = 8) in vec4 color;                        \r\n"
+        "layout(location = 9) in uint slot;                         \r\n"
+        "                                                           \r\n"
+        "out vec2 vTexCoord;                                        \r\n"
+        "out vec4 vColor;                                           \r\n"
+        "flat out uint vSlot;                                       \r\n"
+        "                                                           \r\n"
+        FRAME_DATA_BLOCK
+        "                                                           \r\n"
+        "void main(void)                                            \r\n"
+        "{                                                          \r\n"
+        "    vec2 position = origin + axis_x * corner.x + axis_y * corner.y;\r\n"
+        "                                                           \r\n"
+        "    vColor = color;                                        \r\n"
+        "    vTexCoord = region.xy + corner * region.zw;            \r\n"
+        "    vSlot = slot;                                          \r\n"
+        "                                                           \r\n"
+        "    gl_Position = projection * vec4(position, 0, 1);       \r\n"
+        "}                                                          \r\n";
+
+    //segments arrive in the sprite layout, see transform_line. Everything is measured in the
+    //segment's own frame so the distance to it gives both the round caps and the edge falloff
+    string lineVertexSource =
+        "#version 330                                               \r\n"
+        "layout(location = 0) in vec2 corner;                       \r\n"
+        "layout(location = 4) in vec2 segment;                      \r\n"
+        "layout(location = 5) in vec2 params;                       \r\n"
+        "layout(location = 6) in vec2 origin;                       \r\n"
+        "layout(location = 7) in vec4 joins;                        \r\n"
+        "layout(location = 8) in vec4 color;                        \r\n"
+        "                                                           \r\n"
+        "out vec4 vColor;                                           \r\n"
+        "out vec2 vLocal;                                           \r\n"
+        "flat out float vLength;                                    \r\n"
+        "flat out float vHalfWidth;                                 \r\n"
+        "flat out vec2 vStartClip;                                  \r\n"
+        "flat out vec2 vEndClip;                                    \r\n"
+        "                                                           \r\n"
+        FRAME_DATA_BLOCK
+        "                                                           \r\n"
+        "vec2 unpack_join(float packed)                             \r\n"
+        "{                                                          \r\n"
+        "    float value = packed * 65535.0;                        \r\n"
+        "    if (value < 0.5)                                       \r\n"
+        "        return vec2(0);                                    \r\n"
+        "                                                           \r\n"
+        "    float sine = (value - 1.0) / 32767.0 - 1.0;            \r\n"
+        "    return vec2(sqrt(max(1.0 - sine * sine, 0.0)), sine);  \r\n"
+        "}                                                          \r\n"
+        "                                                           \r\n"
+        "void main(void)                                            \r\n"
+        "{                                                          \r\n"
+        "    float len = length(segment);                           \r\n"
+        "    vec2 dir = len > 0.0 ? segment / len : vec2(1, 0);     \r\n"
+        "    vec2 normal = vec2(-dir.y, dir.x);                     \r\n"
+        "    float reach = params.x + 1.0;                          \r\n"
+        "                                                           \r\n"
+        "    vLocal = vec2(mix(-reach, len + reach, corner.x), mix(-reach, reach, corner.y));\r\n"
+        "    vLength = len;                                         \r\n"
+        "    vHalfWidth = params.x;                                 \r\n"
+        "    vStartClip = unpack_join(joins.x);                     \r\n"
+        "    vEndClip = unpack_join(joins.y);                       \r\n"
+        "    vColor = color;                                        \r\n"
+        "                                                           \r\n"
+        "    vec2 position = origin + dir * vLocal.x + normal * vLocal.y;\r\n"
+        "    gl_Position = projection * vec4(position, 0, 1);       \r\n"
+        "}                                                          \r\n";
+
+    string lineFragmentSource =
+        "#version 330                                               \r\n"
+        "in vec4 vColor;                                            \r\n"
+        "in vec2 vLocal;                                            \r\n"
+        "flat in float vLength;                                     \r\n"
+        "flat in float vHalfWidth;                                  \r\n"
+        "flat in vec2 vStartClip;                                   \r\n"
+        "flat in vec2 vEndClip;                                     \r\n"
+        "out vec4 oColor;                                           \r\n"
+        "                                                           \r\n"
+        "void main(void)                                            \r\n"
+        "{                                                          \r\n"
+        "    //joints are split along their bisector, each side belongs to one segment\r\n"
+        "    if (dot(vLocal, vStartClip) < 0.0 || dot(vLocal - vec2(vLength, 0.0), vEndClip) > 0.0)\r\n"
+        "        discard;                                           \r\n"
+        "                                                           \r\n"
+        "    vec2 offset = vec2(vLocal.x - clamp(vLocal.x, 0.0, vLength), vLocal.y);\r\n"
+        "    float coverage = clamp(vHalfWidth + 0.5 - length(offset), 0.0, 1.0);\r\n"
+        "    oColor = vec4(vColor.rgb, vColor.a * coverage);        \r\n"
+        "}                                                          \r\n";
+
+    //static meshes keep texture space uvs and local positions, both are resolved here
+    string staticVertexSource =
+        "#version 330                                               \r\n"
+        "in vec4 position;                                          \r\n"
+        "in vec4 color;                                             \r\n"
+        "in uint slot;                                              \r\n"
+        "                                                           \r\n"
+        "out vec2 vTexCoord;                                        \r\n"
+        "out vec4 vColor;                                           \r\n"
+        "flat out uint vSlot;                                       \r\n"
+        "                                                           \r\n"
+        FRAME_DATA_BLOCK
+        "uniform mat4 model;                                        \r\n"
+        "uniform vec4 tint;                                         \r\n"
+        "uniform vec4 region;                                       \r\n"
+        "                                                           \r\n"
+        "void main(void)                                            \r\n"
+        "{                                                          \r\n"
+        "    vColor = color * tint;                                 \r\n"
+        "    vTexCoord = region.xy + position.zw * region.zw;       \r\n"
+        "    vSlot = slot;                                          \r\n"
+        "                                                           \r\n"
+        "    gl_Position = projection * model * vec4(position.xy, 0, 1);\r\n"
+        "}                                                          \r\n";
+
     m_default_shader = create_shader(vertexSource, fragmentSource);
     m_default_geom_shader = create_shader(geomVertexSource, geomFragmentSource);
+    m_default_sprite_shader = create_shader(spriteVertexSource, fragmentSource);
+    m_default_line_shader = create_shader(lineVertexSource, lineFragmentSource);
+    m_default_static_shader = create_shader(staticVertexSource, fragmentSource);
+    m_default_static_geom_shader = create_shader(staticVertexSource, geomFragmentSource);
+    m_default_sdf_shader = create_shader(vertexSource, sdfFragmentSource);
 
     m_vertex_attribute = glGetAttribLocation(m_default_shader->get_program(), "position");
     CHECK_GL_ERROR;
     m_color_attribute = glGetAttribLocation(m_default_shader->get_program(), "color");
     CHECK_GL_ERROR;
+    m_slot_attribute = glGetAttribLocation(m_default_shader->get_program(), "slot");
+    CHECK_GL_ERROR;
+
+    for (auto& shader : { m_default_shader, m_default_sprite_shader, m_default_static_shader, m_default_sdf_shader })
+    {
+        GLState::get()->use_program(shader->get_program());
+        for (int32_t i = 0; i < RenderLayer::MAX_TEXTURE_SLOTS; i++)
+        {
+            auto name = "tex[" + to_string(i) + "]";
+            glUniform1i(glGetUniformLocation(shader->get_program(), name.c_str()), i);
+            CHECK_GL_ERROR;
+        }
+
+        shader->set_texture_slots(RenderLayer::MAX_TEXTURE_SLOTS);
+    }
+
+    m_vertex_stream = UNEW_3(StreamBuffer, GL_ARRAY_BUFFER, sizeof(VertexData), sizeof(VertexData) * 65536);
+    m_index_stream = UNEW_3(StreamBuffer, GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t), sizeof(uint16_t) * 65536 * 3);
+    m_instance_stream = UNEW_3(StreamBuffer, GL_ARRAY_BUFFER, sizeof(SpriteInstance), sizeof(SpriteInstance) * 16384);
+    m_frame_buffer = UNEW_2(UniformBuffer, UniformBuffer::FRAME_BINDING, sizeof(FrameData));
+
+    m_start_counter = SDL_GetPerformanceCounter();
+    m_last_counter = m_start_counter;
 
     glEnableVertexAttribArray(m_vertex_attribute);
     CHECK_GL_ERROR;
     glEnableVertexAttribArray(m_color_attribute);
     CHECK_GL_ERROR;
+    glEnableVertexAttribArray(m_slot_attribute);
+    CHECK_GL_ERROR;
+
+    static const float corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+    static const uint16_t quad[] = { 0, 1, 2, 2, 3, 0 };
+
+    glGenVertexArrays(1, &m_sprite_vao);
+    CHECK_GL_ERROR;
+    GLState::get()->bind_vertex_array(m_sprite_vao);
+    glGenBuffers(2, m_quad_buffers);
+    CHECK_GL_ERROR;
+
+    GLState::get()->bind_buffer(GL_ARRAY_BUFFER, m_quad_buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    CHECK_GL_ERROR;
+    GLState::get()->bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_quad_buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    CHECK_GL_ERROR;
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, 0);
+    CHECK_GL_ERROR;
+    glEnableVertexAttribArray(0);
+    CHECK_GL_ERROR;
+
+    for (uint32_t i = 4; i <= 9; i++)
+    {
+        glEnableVertexAttribArray(i);
+        CHECK_GL_ERROR;
+        glVertexAttribDivisor(i, 1);
+        CHECK_GL_ERROR;
+    }
+
+    GLState::get()->bind_vertex_array(m_vao);
 
     m_setup = true;
 }
@@ -296,478 +375,1681 @@ void Canvas::setup()
 void Canvas::begin()
 {
     setup();
+    poll_shaders();
+
+    //only keep as many spare layers around as the last frame used
+    if (m_buffers.size() > m_layers.size())
+        m_buffers.resize(m_layers.size());
 
     for (auto& layer : m_layers)
         m_buffers.emplace_back(move(layer));
 
     m_scissor = false;
+    m_depth = 0;
     m_layers.clear();
+    m_vertex_arena.reset();
+    m_index_arena.reset();
+    m_instance_arena.reset();
+    for (auto id : m_atlas->get_retired())
+        m_textures.erase(id);
+
+    m_atlas->collect();
+    m_glyph_atlas->next_frame();
+
+    if (m_damage_tracking)
+        m_damage->begin();
+
+    m_frame_hash = HASH_OFFSET_BASIS;
+    m_replayed = false;
     m_state->reset();
 
     if (m_viewport_scale_x != 1.0f || m_viewport_scale_y != 1.0f)
-    {
-        fmatrix4 mat;
-        mat = glm::scale(mat, fvec3(m_viewport_scale_x, m_viewport_scale_y, 1.0f));
+        m_state->push_matrix(get_base_matrix());
 
-        m_state->push_matrix(mat);
-    }
+    lock_guard<mutex> lock(m_recorder_mutex);
+    for (auto& recorder : m_recorders)
+        recorder->reset(get_base_matrix(), m_viewport_height);
 }
 
 void Canvas::draw_line(float x1, float y1, float x2, float y2, float strength)
 {
+    if (m_shader != nullptr && m_shader->ready())
+    {
+        tessellate_polyline({ fvec2(x1, y1), fvec2(x2, y2) }, false, strength);
+        return;
+    }
+
+    VertexTransform transform(m_state.get(), nullptr, false, m_viewport_height);
+
+    SpriteInstance instance;
+    transform_line(transform, x1, y1, x2, y2, strength, instance);
+    submit_sprite(nullptr, m_default_line_shader, instance, clip_bounds(get_line_bounds(instance)));
 }
 
 void Canvas::draw_polyline(const vector<fvec2>& points, bool closed, float strength)
 {
-    GeometryData data = polyline(points, closed, strength);
-    draw(data.first, data.second);
-}
+    //the matrix maps into viewport pixels, past one point per pixel the rest can't show up anyway
+    if (points.size() > (size_t)m_viewport_width)
+    {
+        decimate_polyline(points.data(), points.size(), m_state->matrix(), LOD_TOLERANCE, m_lod_points);
+        stroke_polyline(m_lod_points, closed, strength);
+        return;
+    }
 
-void Canvas::draw(const vector<VertexData>& vertices, const vector<unsigned short>& indices, bool flipped_y)
-{
-    draw(nullptr, vertices, indices, flipped_y);
+    stroke_polyline(points, closed, strength);
 }
 
-void Canvas::draw(float x, float y, float w, float h, bool flipped_y)
+void Canvas::draw(LineSeriesPtr series, float strength)
 {
-    draw(nullptr, x, y, w, h, flipped_y);
-}
+    if (series == nullptr || series->size() < 2)
+        return;
 
-void Canvas::draw(float sx, float sy, float sw, float sh, float dx, float dy, bool flipped_y)
-{
-    draw(nullptr, sx, sy, sw, sh, dx, dy, flipped_y);
+    stroke_polyline(series->decimate(m_state->matrix(), LOD_TOLERANCE), false, strength);
 }
 
-void Canvas::draw(float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y)
+void Canvas::stroke_path(PathPtr path, float strength)
 {
-    draw(nullptr, sx, sy, sw, sh, dx, dy, dw, dh, flipped_y);
-}
+    if (path == nullptr || path->empty())
+        return;
 
-void Canvas::draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<unsigned short>& indices, bool flipped_y)
-{
-    get_layer(texture)->draw(vertices, indices, flipped_y);
+    for (auto& contour : path->flatten(get_matrix_scale(), PATH_TOLERANCE))
+        stroke_polyline(contour.points, contour.closed, strength);
 }
 
-void Canvas::draw(TexturePtr texture, float x, float y, float w, float h, bool flipped_y)
+void Canvas::fill_path(PathPtr path, FillRule rule)
 {
-    if (texture == nullptr)
-        draw(texture, 0.0f, 0.0f, w, h, x, y, w, h, flipped_y);
-    else
-        draw(texture, 0.0f, 0.0f, (float)texture->get_width(), (float)texture->get_height(), x, y, w, h, flipped_y);
-}
+    if (path == nullptr || path->empty())
+        return;
 
-void Canvas::draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, bool flipped_y)
-{
-    draw(texture, sx, sy, sw, sh, dx, dy, sw, sh, flipped_y);
-}
+    auto& fill = path->fill(get_matrix_scale(), PATH_TOLERANCE);
+    if (fill.indices.empty())
+        return;
 
-void Canvas::draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y)
-{
-    static vector<VertexData> vertices(4, VertexData());
-    static vector<unsigned short> indices(6, 0);
+    //fringe widths are in local units, a pixel after the matrix
+    auto feather = m_antialiasing ? 1.0f / get_matrix_scale() : 0.0f;
 
-    vertices[0].v.x = dx;      vertices[0].v.y = dy;
-    vertices[1].v.x = dx + dw; vertices[1].v.y = dy;
-    vertices[2].v.x = dx + dw; vertices[2].v.y = dy + dh;
-    vertices[3].v.x = dx;      vertices[3].v.y = dy + dh;
+    if (!fill.stencil)
+    {
+        if (feather == 0.0f)
+        {
+            m_fill_vertices.assign(fill.points.begin(), fill.points.end());
+            draw(nullptr, m_fill_vertices, fill.indices);
+            return;
+        }
 
-    vertices[0].color = 0xffffffff;
-    vertices[1].color = 0xffffffff;
-    vertices[2].color = 0xffffffff;
-    vertices[3].color = 0xffffffff;
+        //the moved points come first, so the cached triangulation indexes them as is
+        m_fill_vertices.clear();
+        m_fill_indices.assign(fill.indices.begin(), fill.indices.end());
+        feather_ring(fill.points.data(), fill.points.size(), feather, ring_orientation(fill.points.data(), fill.points.size()), m_fill_vertices, m_fill_indices);
+        draw(nullptr, m_fill_vertices, m_fill_indices);
+        return;
+    }
 
-    vertices[0].uv.x = 0.0f; vertices[0].uv.y = 0.0f;
-    vertices[1].uv.x = 1.0f; vertices[1].uv.y = 0.0f;
-    vertices[2].uv.x = 1.0f; vertices[2].uv.y = 1.0f;
-    vertices[3].uv.x = 0.0f; vertices[3].uv.y = 1.0f;
+    //fans plus the cover quad over the path's bounds, all in one layer
+    auto vertex_count = fill.points.size() + 4;
+    auto index_count = fill.indices.size() + 6;
+    if (vertex_count > RenderLayer::MAX_NUM_VERTICES || index_count > RenderLayer::MAX_NUM_INDICES)
+    {
+        LogSystem::get()->warn("Path too large to fill");
+        return;
+    }
 
-    indices[0] = 0; indices[1] = 1; indices[2] = 2;
-    indices[3] = 2; indices[4] = 3; indices[5] = 0;
+    auto shader = get_shader(nullptr);
+    VertexTransform transform(m_state.get(), nullptr, false, m_viewport_height);
 
-    draw(texture, vertices, indices, flipped_y);
+    auto vertex_start = m_vertex_arena.allocate(vertex_count);
+    auto index_start = m_index_arena.allocate(index_count);
+    auto* vertices = m_vertex_arena.data(vertex_start);
+    auto* indices = m_index_arena.data(index_start);
+
+    for (size_t i = 0; i < fill.points.size(); i++)
+        vertices[i] = VertexData(fill.points[i]);
+
+    auto& local = fill.bounds;
+    auto cover = (uint32_t)fill.points.size();
+    vertices[cover + 0] = VertexData(fvec2(local.x, local.y));
+    vertices[cover + 1] = VertexData(fvec2(local.z, local.y));
+    vertices[cover + 2] = VertexData(fvec2(local.z, local.w));
+    vertices[cover + 3] = VertexData(fvec2(local.x, local.w));
+
+    memcpy(indices, fill.indices.data(), sizeof(uint32_t) * fill.indices.size());
+    uint32_t quad[6] = { cover, cover + 1, cover + 2, cover, cover + 2, cover + 3 };
+    memcpy(indices + fill.indices.size(), quad, sizeof(quad));
+
+    transform_vertices(transform, vertices, vertices, vertex_count);
+
+    auto bounds = clip_bounds(get_vertex_bounds(vertices, vertex_count));
+    if (tracking())
+    {
+        auto hash = hash_value(transform, get_state_hash(nullptr, shader));
+        hash = hash_bytes(fill.points.data(), sizeof(fvec2) * fill.points.size(), hash_value(rule, hash));
+        track(hash, bounds);
+    }
+
+    get_layer(nullptr, shader, bounds, true)->stencil(vertex_start, vertex_count, index_start, index_count, rule);
+
+    //the fringe's inner half lands on the fill again, which only blends away for opaque colors
+    if (feather > 0.0f && m_state->color().a * m_state->opacity() >= 1.0f)
+        feather_path(path, feather);
 }
 
-void Canvas::end()
+void Canvas::feather_path(PathPtr path, float width)
 {
-    glDisable(GL_SCISSOR_TEST);
-
-    glViewport((uint32_t)m_viewport_x, (uint32_t)m_viewport_y, (uint32_t)m_viewport_width, (uint32_t)m_viewport_height);
-    CHECK_GL_ERROR;
-    glClearColor(m_clear_color.r, m_clear_color.g, m_clear_color.b, m_clear_color.a);
-    CHECK_GL_ERROR;
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    CHECK_GL_ERROR;
+    m_fill_vertices.clear();
+    m_fill_indices.clear();
 
-    fmatrix4 projection = glm::ortho(m_viewport_x, m_viewport_width, m_viewport_y, m_viewport_height, -100.0f, 100.0f);
-    for (auto& batch : m_layers)
+    auto& contours = path->flatten(get_matrix_scale(), PATH_TOLERANCE);
+    for (auto& contour : contours)
     {
-        if(batch->get_shader() != m_last_shader)
+        auto& points = contour.points;
+        if (points.size() < 3)
+            continue;
+
+        //holes are solid outside, rings nested an odd number of times are taken to be holes
+        auto orientation = ring_orientation(points.data(), points.size());
+        for (auto& other : contours)
         {
-            m_last_shader = batch->get_shader();
-            m_last_shader->set_uniform("projection", projection);
-            m_last_shader->apply();
+            if (&other != &contour && other.points.size() >= 3 && point_in_ring(points.front(), other.points.data(), other.points.size()))
+                orientation = -orientation;
         }
 
-        batch->upload(m_vertex_attribute, m_color_attribute);
+        feather_ring(points.data(), points.size(), width, orientation, m_fill_vertices, m_fill_indices);
     }
+
+    if (!m_fill_indices.empty())
+        draw(nullptr, m_fill_vertices, m_fill_indices);
 }
 
-void Canvas::set_clear_color(const Color& color)
+void Canvas::draw_circle(float x, float y, float radius)
 {
-    m_clear_color = color;
+    if (radius <= 0.0f)
+        return;
+
+    auto scale = radius * get_matrix_scale();
+    auto segments = ShapeCache::get_segments(scale, PATH_TOLERANCE);
+    auto local = glm::scale(glm::translate(fmatrix4(), fvec3(x, y, 0.0f)), fvec3(radius, radius, 1.0f));
+    draw_shape(nullptr, m_shape_cache->circle(segments, m_antialiasing ? 1.0f / scale : 0.0f), local);
 }
 
-void Canvas::set_viewport(float x, float y, float w, float h)
+void Canvas::draw_arc(float x, float y, float radius, float start, float end, float thickness)
 {
-    m_viewport_x = x;
-    m_viewport_y = y;
-    m_viewport_width = w;
-    m_viewport_height = h;
+    if (radius <= 0.0f || thickness <= 0.0f || start == end)
+        return;
+
+    auto scale = radius * get_matrix_scale();
+    auto segments = ShapeCache::get_segments(scale, PATH_TOLERANCE);
+    auto local = glm::scale(glm::translate(fmatrix4(), fvec3(x, y, 0.0f)), fvec3(radius, radius, 1.0f));
+    draw_shape(nullptr, m_shape_cache->arc(start, end, max(0.0f, 1.0f - thickness / radius), segments, m_antialiasing ? 1.0f / scale : 0.0f), local);
+}
+
+void Canvas::draw_rounded_rect(float x, float y, float w, float h, float radius)
+{
+    if (w <= 0.0f || h <= 0.0f)
+        return;
+
+    auto scale = get_matrix_scale();
+    auto segments = ShapeCache::get_segments(radius * scale, PATH_TOLERANCE);
+    auto feather = m_antialiasing ? 1.0f / scale : 0.0f;
+    draw_shape(nullptr, m_shape_cache->rounded_rect(w, h, radius, segments, feather), glm::translate(fmatrix4(), fvec3(x, y, 0.0f)));
+}
+
+void Canvas::draw_nine_slice(TexturePtr texture, float left, float top, float right, float bottom, float x, float y, float w, float h)
+{
+    if (texture == nullptr || w <= 0.0f || h <= 0.0f)
+        return;
+
+    //borders shrink evenly when the target is smaller than both of them together
+    auto scale_x = left + right > w ? w / (left + right) : 1.0f;
+    auto scale_y = top + bottom > h ? h / (top + bottom) : 1.0f;
+
+    auto tw = (float)texture->get_width();
+    auto th = (float)texture->get_height();
+    fvec4 insets(left * scale_x, top * scale_y, right * scale_x, bottom * scale_y);
+    fvec4 uv_insets(left / tw, top / th, right / tw, bottom / th);
+
+    draw_shape(texture, m_shape_cache->nine_slice(w, h, insets, uv_insets), glm::translate(fmatrix4(), fvec3(x, y, 0.0f)));
+}
+
+void Canvas::draw_text(FontPtr font, const string& text, float x, float y, float size, bool flipped_y)
+{
+    if (font == nullptr || text.empty() || size <= 0.0f)
+        return;
+
+    //bitmap glyphs are rasterized at the size they cover on screen, distance fields at one size for all
+    auto sdf = font->get_mode() == GlyphMode::SDF;
+    auto pixel_size = sdf ? GlyphAtlas::SDF_SIZE : (int32_t)min(max(roundf(size * get_matrix_scale()), 1.0f), (float)GlyphAtlas::MAX_BITMAP_SIZE);
+    auto ratio = size / pixel_size;
+
+    float ascent, descent, line_gap;
+    font->get_metrics(size, ascent, descent, line_gap);
+
+    for (auto& vertices : m_text_vertices)
+        vertices.clear();
+
+    //glyph boxes come y-down, lines and boxes are mirrored for y-up callers
+    auto down = flipped_y ? 1.0f : -1.0f;
+    auto pen_x = x;
+    auto pen_y = y + ascent * down;
+    //the transform applies the state color and opacity
+    uint32_t color = 0xFFFFFFFF;
+    int32_t previous = -1;
+    size_t offset = 0;
+
+    while (offset < text.size())
+    {
+        auto codepoint = Font::next_codepoint(text, offset);
+        if (codepoint == '\n')
+        {
+            pen_x = x;
+            pen_y += (ascent - descent + line_gap) * down;
+            previous = -1;
+            continue;
+        }
+
+        auto index = font->find_glyph(codepoint);
+        if (previous != -1)
+            pen_x += font->get_kerning(previous, index, size);
+
+        //copied, the entry can be evicted by a later glyph of the same run
+        auto glyph = m_glyph_atlas->get(font, index, pixel_size);
+        if (glyph.page != -1)
+        {
+            if ((size_t)glyph.page >= m_text_vertices.size())
+                m_text_vertices.resize(glyph.page + 1);
+
+            auto x0 = pen_x + glyph.quad.x * ratio;
+            auto y0 = pen_y + glyph.quad.y * ratio * down;
+            auto x1 = pen_x + glyph.quad.z * ratio;
+            auto y1 = pen_y + glyph.quad.w * ratio * down;
+
+            auto& vertices = m_text_vertices[glyph.page];
+            vertices.emplace_back(fvec2(x0, y0), fvec2(glyph.uv.x, glyph.uv.y), color);
+            vertices.emplace_back(fvec2(x1, y0), fvec2(glyph.uv.z, glyph.uv.y), color);
+            vertices.emplace_back(fvec2(x1, y1), fvec2(glyph.uv.z, glyph.uv.w), color);
+            vertices.emplace_back(fvec2(x0, y1), fvec2(glyph.uv.x, glyph.uv.w), color);
+        }
+
+        pen_x += glyph.advance * ratio;
+        previous = index;
+    }
+
+    ShaderPtr shader = sdf ? m_default_sdf_shader : m_default_shader;
+    if (m_shader != nullptr && m_shader->ready())
+        shader = m_shader;
+
+    //each page goes out as one draw, the layer picks them up in separate texture slots
+    for (size_t page = 0; page < m_text_vertices.size(); page++)
+    {
+        auto& vertices = m_text_vertices[page];
+        if (vertices.empty())
+            continue;
+
+        for (auto i = (uint32_t)(m_text_indices.size() / 6 * 4); i < vertices.size(); i += 4)
+        {
+            m_text_indices.push_back(i);
+            m_text_indices.push_back(i + 1);
+            m_text_indices.push_back(i + 2);
+            m_text_indices.push_back(i + 2);
+            m_text_indices.push_back(i + 3);
+            m_text_indices.push_back(i);
+        }
+
+        auto texture = m_glyph_atlas->get_texture((int32_t)page);
+        VertexTransform transform(m_state.get(), texture, flipped_y, m_viewport_height);
+        submit(texture, shader, vertices.data(), vertices.size(), m_text_indices.data(), vertices.size() / 4 * 6, transform, get_bounds(vertices, flipped_y));
+    }
+}
+
+fvec2 Canvas::measure_text(FontPtr font, const string& text, float size)
+{
+    if (font == nullptr || text.empty() || size <= 0.0f)
+        return fvec2();
+
+    float ascent, descent, line_gap;
+    font->get_metrics(size, ascent, descent, line_gap);
+
+    float width = 0.0f;
+    float line = 0.0f;
+    float height = ascent - descent;
+    int32_t previous = -1;
+    size_t offset = 0;
+
+    while (offset < text.size())
+    {
+        auto codepoint = Font::next_codepoint(text, offset);
+        if (codepoint == '\n')
+        {
+            width = max(width, line);
+            line = 0.0f;
+            height += ascent - descent + line_gap;
+            previous = -1;
+            continue;
+        }
+
+        auto index = font->find_glyph(codepoint);
+        if (previous != -1)
+            line += font->get_kerning(previous, index, size);
+
+        line += font->get_advance(index, size);
+        previous = index;
+    }
+
+    return fvec2(max(width, line), height);
+}
+
+void Canvas::draw_shape(TexturePtr texture, const ShapeMesh& mesh, const fmatrix4& local)
+{
+    //the mesh goes out as cached, the placement rides along in the transform
+    auto matrix = m_state->matrix() * local;
+    auto region = texture == nullptr ? fvec4(0.0f, 0.0f, 1.0f, 1.0f) : texture->get_region();
+    VertexTransform transform(matrix, region, (Color(m_state->color()) * m_state->opacity()).uint, 0, false, m_viewport_height);
+
+    submit(texture, get_shader(texture), mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), transform, get_bounds(matrix, mesh.bounds, false));
+}
+
+void Canvas::stroke_polyline(const vector<fvec2>& points, bool closed, float strength)
+{
+    //custom shaders expect regular vertex data
+    if (m_shader != nullptr && m_shader->ready())
+    {
+        tessellate_polyline(points, closed, strength);
+        return;
+    }
+
+    if (points.size() < 2)
+        return;
+
+    VertexTransform transform(m_state.get(), nullptr, false, m_viewport_height);
+
+    //one instance per segment, their round caps are split at each joint so it's covered once
+    auto segments = closed && points.size() > 2 ? points.size() : points.size() - 1;
+    m_line_instances.resize(segments);
+
+    for (size_t i = 0; i < segments; i++)
+    {
+        auto& a = points[i];
+        auto& b = points[(i + 1) % points.size()];
+        transform_line(transform, a.x, a.y, b.x, b.y, strength, m_line_instances[i]);
+
+        if (i > 0)
+            join_lines(m_line_instances[i - 1], m_line_instances[i]);
+    }
+
+    if (closed && segments > 2)
+        join_lines(m_line_instances[segments - 1], m_line_instances[0]);
+
+    for (auto& instance : m_line_instances)
+        submit_sprite(nullptr, m_default_line_shader, instance, clip_bounds(get_line_bounds(instance)));
+}
+
+void Canvas::tessellate_polyline(const vector<fvec2>& points, bool closed, float strength)
+{
+    auto count = points.size();
+    auto pieces = polyline_pieces(count, closed);
+    if (pieces == 0)
+        return;
+
+    auto shader = get_shader(nullptr);
+    VertexTransform transform(m_state.get(), nullptr, false, m_viewport_height);
+
+    //chunks stay small enough for a fresh layer to always take one
+    const size_t chunk = RenderLayer::MAX_NUM_VERTICES / POLYLINE_PIECE_VERTICES / 4;
+
+    for (size_t first = 0; first < pieces; first += chunk)
+    {
+        auto chunk_pieces = min(chunk, pieces - first);
+        auto vertex_count = polyline_vertices(count, chunk_pieces);
+        auto index_count = polyline_indices(count, chunk_pieces);
+
+        //tessellated straight into the arenas, the layer picked afterwards only takes the range over
+        auto vertex_start = m_vertex_arena.allocate(vertex_count);
+        auto index_start = m_index_arena.allocate(index_count);
+        auto* vertices = m_vertex_arena.data(vertex_start);
+
+        polyline(points.data(), count, closed, strength, first, chunk_pieces, vertices, m_index_arena.data(index_start));
+        transform_vertices(transform, vertices, vertices, vertex_count);
+
+        auto bounds = clip_bounds(get_vertex_bounds(vertices, vertex_count));
+        if (tracking())
+        {
+            //a chunk depends on the points around its joints plus both ends for the wrap around
+            auto end = min(count, first + chunk_pieces + 2);
+            auto hash = hash_value(transform, get_state_hash(nullptr, shader));
+            hash = hash_value(strength, hash_value(first, hash_value(closed, hash)));
+            hash = hash_bytes(&points[first], sizeof(fvec2) * (end - first), hash);
+            track(hash_value(points.front(), hash_value(points.back(), hash)), bounds);
+        }
+
+        if (!get_layer(nullptr, shader, bounds)->claim(nullptr, vertex_start, vertex_count, index_start, index_count))
+            get_layer(nullptr, shader, bounds, true)->claim(nullptr, vertex_start, vertex_count, index_start, index_count);
+    }
+}
+
+void Canvas::draw(const vector<VertexData>& vertices, const vector<unsigned short>& indices, bool flipped_y)
+{
+    draw(nullptr, vertices, indices, flipped_y);
+}
+
+void Canvas::draw(const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y)
+{
+    draw(nullptr, vertices, indices, flipped_y);
+}
+
+void Canvas::draw(float x, float y, float w, float h, bool flipped_y)
+{
+    draw(nullptr, x, y, w, h, flipped_y);
+}
+
+void Canvas::draw(float sx, float sy, float sw, float sh, float dx, float dy, bool flipped_y)
+{
+    draw(nullptr, sx, sy, sw, sh, dx, dy, flipped_y);
+}
+
+void Canvas::draw(float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y)
+{
+    draw(nullptr, sx, sy, sw, sh, dx, dy, dw, dh, flipped_y);
+}
+
+void Canvas::draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<unsigned short>& indices, bool flipped_y)
+{
+    VertexTransform transform(m_state.get(), texture, flipped_y, m_viewport_height);
+    submit(texture, get_shader(texture), vertices.data(), vertices.size(), indices.data(), indices.size(), transform, get_bounds(vertices, flipped_y));
+}
+
+void Canvas::draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y)
+{
+    VertexTransform transform(m_state.get(), texture, flipped_y, m_viewport_height);
+    submit(texture, get_shader(texture), vertices.data(), vertices.size(), indices.data(), indices.size(), transform, get_bounds(vertices, flipped_y));
+}
+
+void Canvas::draw(TexturePtr texture, float x, float y, float w, float h, bool flipped_y)
+{
+    if (texture == nullptr)
+        draw(texture, 0.0f, 0.0f, w, h, x, y, w, h, flipped_y);
+    else
+        draw(texture, 0.0f, 0.0f, (float)texture->get_width(), (float)texture->get_height(), x, y, w, h, flipped_y);
+}
+
+void Canvas::draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, bool flipped_y)
+{
+    draw(texture, sx, sy, sw, sh, dx, dy, sw, sh, flipped_y);
+}
+
+void Canvas::draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y)
+{
+    //custom shaders expect regular vertex data
+    if (texture != nullptr && (m_shader == nullptr || !m_shader->ready()))
+    {
+        draw_sprite(texture, dx, dy, dw, dh, flipped_y);
+        return;
+    }
+
+    static vector<VertexData> vertices(4, VertexData());
+    static vector<unsigned short> indices(6, 0);
+
+    vertices[0].v.x = dx;      vertices[0].v.y = dy;
+    vertices[1].v.x = dx + dw; vertices[1].v.y = dy;
+    vertices[2].v.x = dx + dw; vertices[2].v.y = dy + dh;
+    vertices[3].v.x = dx;      vertices[3].v.y = dy + dh;
+
+    vertices[0].color = 0xffffffff;
+    vertices[1].color = 0xffffffff;
+    vertices[2].color = 0xffffffff;
+    vertices[3].color = 0xffffffff;
+
+    vertices[0].uv.x = 0.0f; vertices[0].uv.y = 0.0f;
+    vertices[1].uv.x = 1.0f; vertices[1].uv.y = 0.0f;
+    vertices[2].uv.x = 1.0f; vertices[2].uv.y = 1.0f;
+    vertices[3].uv.x = 0.0f; vertices[3].uv.y = 1.0f;
+
+    indices[0] = 0; indices[1] = 1; indices[2] = 2;
+    indices[3] = 2; indices[4] = 3; indices[5] = 0;
+
+    draw(texture, vertices, indices, flipped_y);
+}
+
+void Canvas::draw(StaticMeshPtr mesh)
+{
+    if (mesh == nullptr || mesh->get_index_count() == 0)
+        return;
+
+    //uploading binds the mesh's own vertex array
+    mesh->upload();
+    GLState::get()->bind_vertex_array(m_vao);
+
+    auto& local = mesh->get_bounds();
+    auto& transform = m_state->matrix();
+
+    fvec4 bounds(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int32_t i = 0; i < 4; i++)
+    {
+        fvec4 corner = transform * fvec4(i & 1 ? local.z : local.x, i & 2 ? local.w : local.y, 0.0f, 1.0f);
+
+        bounds.x = min(bounds.x, corner.x);
+        bounds.y = min(bounds.y, corner.y);
+        bounds.z = max(bounds.z, corner.x);
+        bounds.w = max(bounds.w, corner.y);
+    }
+
+    auto texture = mesh->get_texture();
+    auto shader = texture == nullptr ? m_default_static_geom_shader : m_default_static_shader;
+
+    Color tint = m_state->color();
+    tint *= m_state->opacity();
+
+    bounds = clip_bounds(bounds);
+    if (tracking())
+    {
+        auto hash = hash_value(mesh->get_version(), get_state_hash(texture, shader));
+        track(hash_value(mesh.get(), hash_value(transform, hash_value(tint.uint, hash))), bounds);
+    }
+
+    get_layer(texture, shader, bounds, true)->draw(mesh, transform, fvec4(tint.r, tint.g, tint.b, tint.a));
+}
+
+void Canvas::end()
+{
+    flush_recorders();
+
+    m_last_frame_hash = m_frame_hash;
+    m_invalidated = false;
+
+    m_stats = {};
+    m_stats.batches = (int32_t)m_layers.size();
+
+    //layers only ever merge with layers of the same depth, so ordering by depth is all that's left
+    stable_sort(m_layers.begin(), m_layers.end(), [](const RenderLayerPtr& a, const RenderLayerPtr& b)
+    {
+        return a->get_depth() < b->get_depth();
+    });
+
+#define ALIGN_INDEX(OFFSET) (((OFFSET) + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1))
+    size_t vertex_count = 0;
+    size_t index_bytes = 0;
+    size_t instance_count = 0;
+    for (auto& batch : m_layers)
+    {
+        if (batch->instanced())
+        {
+            m_stats.instances += batch->get_instance_count();
+            instance_count += batch->get_instance_count();
+            continue;
+        }
+
+        m_stats.vertices += batch->get_vertex_count();
+        m_stats.indices += batch->get_index_count();
+        vertex_count += batch->get_vertex_count();
+        index_bytes = ALIGN_INDEX(index_bytes) + batch->get_index_size() * batch->get_index_count();
+    }
+
+    //with damage tracking only the regions that changed since the back buffer was last drawn get repainted
+    bool partial = false;
+    if (m_damage_tracking)
+        partial = m_damage->compute(m_buffer_age, ivec4(0, 0, (int32_t)m_viewport_width, (int32_t)m_viewport_height), m_damage_rects);
+
+    m_stats.damage_rects = partial ? (int32_t)m_damage_rects.size() : 1;
+    m_stats.redrawn_area = 1.0f;
+
+    if (partial)
+    {
+        int64_t area = 0;
+        for (auto& rect : m_damage_rects)
+            area += (int64_t)rect.z * rect.w;
+
+        m_stats.redrawn_area = (float)((double)area / max(1.0f, m_viewport_width * m_viewport_height));
+
+        if (m_damage_rects.empty())
+            return;
+    }
+
+    auto avoided = GLState::get()->get_avoided_calls();
+    GLState::get()->set_scissor(false);
+
+    glViewport((uint32_t)m_viewport_x, (uint32_t)m_viewport_y, (uint32_t)m_viewport_width, (uint32_t)m_viewport_height);
+    CHECK_GL_ERROR;
+    glClearColor(m_clear_color.r, m_clear_color.g, m_clear_color.b, m_clear_color.a);
+    CHECK_GL_ERROR;
+
+    if (!partial)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        CHECK_GL_ERROR;
+    }
+
+    //damaged regions still need clearing when everything in them went away
+    if (m_layers.empty() && !partial)
+        return;
+
+    //unmapping the index stream binds it to whatever vertex array is current
+    GLState::get()->bind_vertex_array(m_vao);
+
+    auto* vertices = (VertexData*)m_vertex_stream->map(sizeof(VertexData) * vertex_count);
+    auto* indices = m_index_stream->map(index_bytes);
+    auto* instances = (SpriteInstance*)m_instance_stream->map(sizeof(SpriteInstance) * instance_count);
+    auto vertex_base = (int32_t)(m_vertex_stream->get_offset() / sizeof(VertexData));
+    auto index_offset = m_index_stream->get_offset();
+    auto instance_offset = m_instance_stream->get_offset();
+    size_t index_position = 0;
+
+    for (auto& batch : m_layers)
+    {
+        if (batch->instanced())
+        {
+            batch->upload(instances, instance_offset);
+            instances += batch->get_instance_count();
+            instance_offset += sizeof(SpriteInstance) * batch->get_instance_count();
+            continue;
+        }
+
+        index_position = ALIGN_INDEX(index_position);
+        batch->upload(vertices, indices + index_position, vertex_base, index_offset + index_position);
+
+        vertices += batch->get_vertex_count();
+        vertex_base += batch->get_vertex_count();
+        index_position += batch->get_index_size() * batch->get_index_count();
+    }
+#undef ALIGN_INDEX
+
+    m_vertex_stream->unmap();
+    m_index_stream->unmap();
+    m_instance_stream->unmap();
+
+    //the vertex array remembers both streams, only point it at them again once they were reallocated
+    if (m_index_generation != m_index_stream->get_generation())
+    {
+        GLState::get()->bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_index_stream->get_buffer());
+        m_index_generation = m_index_stream->get_generation();
+    }
+
+    if (m_vertex_generation != m_vertex_stream->get_generation())
+    {
+        GLState::get()->bind_buffer(GL_ARRAY_BUFFER, m_vertex_stream->get_buffer());
+
+#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
+        glVertexAttribPointer(m_vertex_attribute, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, v));
+        CHECK_GL_ERROR;
+        glVertexAttribPointer(m_color_attribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, color));
+        CHECK_GL_ERROR;
+        glVertexAttribIPointer(m_slot_attribute, 1, GL_UNSIGNED_INT, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, slot));
+        CHECK_GL_ERROR;
+#undef OFFSETOF
+
+        m_vertex_generation = m_vertex_stream->get_generation();
+    }
+
+    fmatrix4 projection = glm::ortho(m_viewport_x, m_viewport_width, m_viewport_y, m_viewport_height, -100.0f, 100.0f);
+    auto counter = SDL_GetPerformanceCounter();
+    auto frequency = (double)SDL_GetPerformanceFrequency();
+
+    FrameData frame = {};
+    frame.projection = projection;
+    frame.viewport = fvec4(m_viewport_x, m_viewport_y, m_viewport_width, m_viewport_height);
+    frame.time = (float)((counter - m_start_counter) / frequency);
+    frame.delta_time = (float)((counter - m_last_counter) / frequency);
+    m_last_counter = counter;
+
+    m_frame_buffer->update(&frame, sizeof(frame));
+    m_frame_buffer->bind();
+
+    if (!partial)
+    {
+        render_batches(projection, nullptr);
+    }
+    else
+    {
+        for (auto& rect : m_damage_rects)
+        {
+            GLState::get()->set_scissor(true, rect.x, rect.y, rect.z, rect.w);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            CHECK_GL_ERROR;
+
+            render_batches(projection, &rect);
+        }
+    }
+
+    m_vertex_stream->fence();
+    m_index_stream->fence();
+    m_instance_stream->fence();
+
+    m_stats.avoided_calls = (int32_t)(GLState::get()->get_avoided_calls() - avoided);
+}
+
+void Canvas::set_clear_color(const Color& color)
+{
+    if (m_clear_color != color)
+        invalidate();
+
+    m_clear_color = color;
+}
+
+void Canvas::set_viewport(float x, float y, float w, float h)
+{
+    if (x != m_viewport_x || y != m_viewport_y || w != m_viewport_width || h != m_viewport_height)
+        invalidate();
+
+    m_viewport_x = x;
+    m_viewport_y = y;
+    m_viewport_width = w;
+    m_viewport_height = h;
 }
 
 void Canvas::set_viewport_scaling(float x, float y)
 {
+    if (x != m_viewport_scale_x || y != m_viewport_scale_y)
+        invalidate();
+
     m_viewport_scale_x = x;
     m_viewport_scale_y = y;
 }
 
-void Canvas::set_scissor(bool enabled, float x, float y, float w, float h)
-{
-    m_scissor = enabled;
-    m_scissor_x = x;
-    m_scissor_y = y;
-    m_scissor_width = w;
-    m_scissor_height = h;
+void Canvas::set_scissor(bool enabled, float x, float y, float w, float h)
+{
+    m_scissor = enabled;
+    m_scissor_x = x;
+    m_scissor_y = y;
+    m_scissor_width = w;
+    m_scissor_height = h;
+}
+
+void Canvas::set_damage_tracking(bool enabled)
+{
+    if (enabled && !m_damage_tracking)
+        m_damage->invalidate();
+
+    m_damage_tracking = enabled;
+}
+
+void Canvas::set_buffer_age(int32_t age)
+{
+    m_buffer_age = age;
+}
+
+void Canvas::set_idle_detection(bool enabled)
+{
+    m_idle_detection = enabled;
+}
+
+void Canvas::set_shader_cache(const string& directory)
+{
+    m_program_cache = directory.empty() ? nullptr : UNEW_1(ProgramCache, directory);
+}
+
+void Canvas::set_shape_cache_budget(size_t bytes)
+{
+    m_shape_cache->set_budget(bytes);
+}
+
+void Canvas::invalidate()
+{
+    m_damage->invalidate();
+    m_invalidated = true;
+}
+
+bool Canvas::frame_changed()
+{
+    if (!m_idle_detection)
+        return true;
+
+    flush_recorders();
+    return m_invalidated || m_frame_hash != m_last_frame_hash;
+}
+
+void Canvas::set_antialiasing(bool enabled)
+{
+    m_antialiasing = enabled;
+}
+
+void Canvas::set_texture_atlas(bool enabled)
+{
+    m_atlas_enabled = enabled;
+}
+
+void Canvas::set_depth(int32_t depth)
+{
+    m_depth = depth;
+}
+
+void Canvas::set_shader(ShaderPtr shader)
+{
+    m_shader = shader;
+}
+
+bool Canvas::scissor_test()
+{
+    return m_scissor;
+}
+
+float Canvas::get_scissor_x()
+{
+    return m_scissor_x;
+}
+
+float Canvas::get_scissor_y()
+{
+    return m_scissor_y;
+}
+
+float Canvas::get_scissor_width()
+{
+    return m_scissor_width;
+}
+
+float Canvas::get_scissor_height()
+{
+    return m_scissor_height;
+}
+
+int32_t Canvas::get_depth()
+{
+    return m_depth;
+}
+
+float Canvas::get_viewport_x()
+{
+    return m_viewport_x;
+}
+
+float Canvas::get_viewport_y()
+{
+    return m_viewport_y;
+}
+
+float Canvas::get_viewport_width()
+{
+    return m_viewport_width;
+}
+
+float Canvas::get_viewport_height()
+{
+    return m_viewport_height;
+}
+
+TexturePtr Canvas::create_texture(unsigned char* pixels, int32_t width, int32_t height, ColorFormat format)
+{
+    if (m_atlas_enabled && m_atlas->fits(width, height))
+    {
+        auto texture = m_atlas->insert(pixels, width, height);
+        if (texture != nullptr)
+        {
+            //entries share their page's id, looking that up gives the page as a whole
+            m_textures[texture->get_id()] = m_atlas->get_page(texture->get_id());
+            return texture;
+        }
+    }
+
+    uint32_t texture;
+    glGenTextures(1, &texture);
+    CHECK_GL_ERROR;
+    GLState::get()->bind_texture(0, texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    CHECK_GL_ERROR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    CHECK_GL_ERROR;
+
+    //todo: actually use format
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    CHECK_GL_ERROR;
+
+    TexturePtr p = NEW_3(Texture, texture, (float)width, (float)height);
+    m_textures[texture] = p;
+
+    return p;
+}
+
+TexturePtr Canvas::create_texture(string file)
+{
+    FILE *fp = nullptr;
+
+#ifdef _WIN32
+    fopen_s(&fp, file.c_str(), "rb");
+#else
+    fp = fopen(file.c_str(), "rb");
+#endif
+
+    if (fp == nullptr)
+        return nullptr;
+
+    char header[8];
+    fread(header, 1, 8, fp);
+
+    if (png_sig_cmp((png_const_bytep)header, 0, 8))
+        return nullptr;
+
+    auto png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (png_ptr == nullptr)
+        return nullptr;
+
+    auto info_ptr = png_create_info_struct(png_ptr);
+    if (info_ptr == nullptr)
+    {
+        png_destroy_read_struct(&png_ptr, nullptr, nullptr);
+        return nullptr;
+    }
+
+    //todo: add error handlers
+
+    png_init_io(png_ptr, fp);
+    png_set_sig_bytes(png_ptr, 8);
+    png_read_info(png_ptr, info_ptr);
+
+    auto width = png_get_image_width(png_ptr, info_ptr);
+    auto height = png_get_image_height(png_ptr, info_ptr);
+    auto channels = png_get_channels(png_ptr, info_ptr);
+
+    png_read_update_info(png_ptr, info_ptr);
+
+    auto tmp = png_get_rowbytes(png_ptr, info_ptr);
+    unsigned char* pixeldata = new unsigned char[height * tmp];
+    png_bytep* row_pointers = new png_bytep[height];
+
+    for (size_t y = 0; y < height; y++)
+        row_pointers[y] = pixeldata + ((height - y - 1) * tmp);
+
+    png_read_image(png_ptr, row_pointers);
+    fclose(fp);
+
+    if (channels == 3)
+    {
+        unsigned char* pixeldata2 = new unsigned char[width * height * 4];
+        for (size_t y = 0; y < height; y++)
+        {
+            for (size_t x = 0; x < width; x++)
+            {
+                pixeldata2[((y * width) + x) * 4 + 0] = pixeldata[((y * width) + x) * 3 + 0];
+                pixeldata2[((y * width) + x) * 4 + 1] = pixeldata[((y * width) + x) * 3 + 1];
+                pixeldata2[((y * width) + x) * 4 + 2] = pixeldata[((y * width) + x) * 3 + 2];
+                pixeldata2[((y * width) + x) * 4 + 3] = 255;
+            }
+        }
+
+        delete[] pixeldata;
+        pixeldata = pixeldata2;
+    }
+
+    TexturePtr tex = create_texture(pixeldata, width, height);
+
+    delete[] pixeldata;
+    delete[] row_pointers;
+
+    png_destroy_info_struct((png_structp)info_ptr, nullptr);
+    png_destroy_read_struct(&png_ptr, nullptr, nullptr);
+
+    return tex;
+}
+
+TexturePtr Canvas::create_texture(TextureID id)
+{
+    if (m_textures.find(id) == m_textures.end())
+        return nullptr;
+
+    return m_textures[id];
+}
+
+//FRAME_DATA_BLOCK declares time and delta_time once, any further mention is a use
+static bool reads_frame_time(const string& source)
+{
+    int32_t mentions = 0;
+    for (size_t i = 0; i < source.size();)
+    {
+        if (!isalpha((uint8_t)source[i]) && source[i] != '_')
+        {
+            i++;
+            continue;
+        }
+
+        auto start = i;
+        while (i < source.size() && (isalnum((uint8_t)source[i]) || source[i] == '_'))
+            i++;
+
+        auto length = i - start;
+        if ((length == 4 && source.compare(start, 4, "time") == 0) || (length == 10 && source.compare(start, 10, "delta_time") == 0))
+            mentions++;
+    }
+
+    return mentions > 2;
+}
+
+ShaderPtr Canvas::create_shader(const string& vertex, const string& fragment)
+{
+    uint32_t program = m_program_cache != nullptr ? m_program_cache->load(vertex, fragment) : 0;
+    if (program == 0)
+    {
+        auto start = SDL_GetPerformanceCounter();
+
+        program = compile_program(vertex, fragment);
+        if (program == 0)
+            return nullptr;
+
+        if (m_program_cache != nullptr)
+            m_program_cache->store(program, vertex, fragment, (float)((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency()));
+    }
+
+    UniformBuffer::attach(program);
+
+    auto shader = NEW_1(Shader, program);
+    shader->set_animated(reads_frame_time(vertex) || reads_frame_time(fragment));
+    return shader;
+}
+
+ShaderPtr Canvas::create_shader_async(const string& vertex, const string& fragment)
+{
+    uint32_t program = m_program_cache != nullptr ? m_program_cache->load(vertex, fragment) : 0;
+    auto animated = reads_frame_time(vertex) || reads_frame_time(fragment);
+    if (program != 0)
+    {
+        UniformBuffer::attach(program);
+
+        auto shader = NEW_1(Shader, program);
+        shader->set_animated(animated);
+        return shader;
+    }
+
+    PendingShader pending;
+    pending.shader = NEW_1(Shader, 0);
+    pending.shader->set_animated(animated);
+    pending.vertex = vertex;
+    pending.fragment = fragment;
+    pending.start = SDL_GetPerformanceCounter();
+    pending.program = link_program(vertex, fragment, pending.vertex_shader, pending.fragment_shader);
+
+    m_pending_shaders.push_back(pending);
+    return pending.shader;
+}
+
+uint32_t Canvas::compile_program(const string& vertex, const string& fragment)
+{
+    uint32_t vertex_shader = 0;
+    uint32_t fragment_shader = 0;
+
+    auto program = link_program(vertex, fragment, vertex_shader, fragment_shader);
+    return finish_program(program, vertex_shader, fragment_shader) ? program : 0;
+}
+
+uint32_t Canvas::link_program(const string& vertex, const string& fragment, uint32_t& vertex_shader, uint32_t& fragment_shader)
+{
+    //nothing in here waits on the driver, the status checks happen in finish_program
+    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    CHECK_GL_ERROR;
+
+    auto vsource = vertex.c_str();
+    int32_t vlength = (int32_t)vertex.length();
+
+    glShaderSource(vertex_shader, 1, &vsource, &vlength);
+    CHECK_GL_ERROR;
+    glCompileShader(vertex_shader);
+    CHECK_GL_ERROR;
+
+    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    CHECK_GL_ERROR;
+
+    auto fsource = fragment.c_str();
+    int32_t flength = (int32_t)fragment.length();
+
+    glShaderSource(fragment_shader, 1, &fsource, &flength);
+    CHECK_GL_ERROR;
+    glCompileShader(fragment_shader);
+    CHECK_GL_ERROR;
+
+    uint32_t program = glCreateProgram();
+    CHECK_GL_ERROR;
+    glAttachShader(program, vertex_shader);
+    CHECK_GL_ERROR;
+    glAttachShader(program, fragment_shader);
+    CHECK_GL_ERROR;
+
+    glBindAttribLocation(program, 0, "position");
+    CHECK_GL_ERROR;
+    glBindAttribLocation(program, 1, "color");
+    CHECK_GL_ERROR;
+    glBindAttribLocation(program, 2, "texcoord");
+    CHECK_GL_ERROR;
+    glBindAttribLocation(program, 3, "slot");
+    CHECK_GL_ERROR;
+
+    if (m_program_cache != nullptr && m_program_cache->supported())
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        CHECK_GL_ERROR;
+    }
+
+    glLinkProgram(program);
+    CHECK_GL_ERROR;
+
+    return program;
+}
+
+bool Canvas::finish_program(uint32_t program, uint32_t vertex_shader, uint32_t fragment_shader)
+{
+    static char log[2048];
+
+    int32_t success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    CHECK_GL_ERROR;
+
+    if (success == GL_TRUE)
+    {
+        glDetachShader(program, vertex_shader);
+        CHECK_GL_ERROR;
+        glDetachShader(program, fragment_shader);
+        CHECK_GL_ERROR;
+
+        return true;
+    }
+
+    //a failed link usually means one of the stages didn't compile, report that one instead
+    for (auto shader : { vertex_shader, fragment_shader })
+    {
+        success = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        CHECK_GL_ERROR;
+
+        if (success == GL_TRUE)
+            continue;
+
+        int32_t logSize = 0;
+        memset(log, 0, 2048);
+
+        glGetShaderInfoLog(shader, 2048, &logSize, log);
+        CHECK_GL_ERROR;
+
+        LogSystem::get()->err(shader == vertex_shader ? "Failed to vertex shader: %s" : "Failed to fragment shader: %s", log);
+        break;
+    }
+
+    if (success == GL_TRUE)
+    {
+        int32_t maxLength = 0;
+        memset(log, 0, 2048);
+
+        glGetProgramInfoLog(program, 2048, &maxLength, log);
+        CHECK_GL_ERROR;
+
+        LogSystem::get()->err("Failed to link shader: %s", log);
+    }
+
+    glDeleteProgram(program);
+    CHECK_GL_ERROR;
+    glDeleteShader(vertex_shader);
+    CHECK_GL_ERROR;
+    glDeleteShader(fragment_shader);
+    CHECK_GL_ERROR;
+
+    return false;
+}
+
+void Canvas::poll_shaders()
+{
+    for (auto it = m_pending_shaders.begin(); it != m_pending_shaders.end();)
+    {
+        //without the extension the status query blocks, by now the driver at least had a frame to work on it
+        if (m_parallel_compile)
+        {
+            int32_t done = GL_FALSE;
+            glGetProgramiv(it->program, GL_COMPLETION_STATUS_KHR, &done);
+            CHECK_GL_ERROR;
+
+            if (done == GL_FALSE)
+            {
+                ++it;
+                continue;
+            }
+        }
+
+        //a shader that failed leaves the list without ever becoming ready,
+        //its draws keep falling back to the defaults
+        if (finish_program(it->program, it->vertex_shader, it->fragment_shader))
+        {
+            if (m_program_cache != nullptr)
+                m_program_cache->store(it->program, it->vertex, it->fragment, (float)((SDL_GetPerformanceCounter() - it->start) * 1000.0 / SDL_GetPerformanceFrequency()));
+
+            UniformBuffer::attach(it->program);
+            it->shader->set_program(it->program);
+        }
+
+        it = m_pending_shaders.erase(it);
+    }
+}
+
+FontPtr Canvas::create_font(const string& file, GlyphMode mode)
+{
+    FILE *fp = nullptr;
+
+#ifdef _WIN32
+    fopen_s(&fp, file.c_str(), "rb");
+#else
+    fp = fopen(file.c_str(), "rb");
+#endif
+
+    if (fp == nullptr)
+    {
+        LogSystem::get()->err("Failed to open font %s", file.c_str());
+        return nullptr;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    auto size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    vector<uint8_t> data(size > 0 ? size : 0);
+    auto read = fread(data.data(), 1, data.size(), fp);
+    fclose(fp);
+
+    if (read != data.size())
+    {
+        LogSystem::get()->err("Failed to read font %s", file.c_str());
+        return nullptr;
+    }
+
+    //the constructor is private, make_shared can't reach it
+    FontPtr font(new Font(mode));
+    if (!font->load(move(data)))
+        return nullptr;
+
+    return font;
 }
 
-void Canvas::set_shader(ShaderPtr shader)
+FontPtr Canvas::create_font(const uint8_t* data, size_t size, GlyphMode mode)
 {
-    m_shader = shader;
+    FontPtr font(new Font(mode));
+    if (!font->load(vector<uint8_t>(data, data + size)))
+        return nullptr;
+
+    return font;
 }
 
-bool Canvas::scissor_test()
+StaticMeshPtr Canvas::create_static_mesh(TexturePtr texture)
 {
-    return m_scissor;
+    return NEW_1(StaticMesh, texture);
 }
 
-float Canvas::get_scissor_x()
+CommandRecorder* Canvas::create_recorder()
 {
-    return m_scissor_x;
+    lock_guard<mutex> lock(m_recorder_mutex);
+    m_recorders.push_back(UNEW_1(CommandRecorder, this));
+    m_recorders.back()->reset(get_base_matrix(), m_viewport_height);
+
+    return m_recorders.back().get();
 }
 
-float Canvas::get_scissor_y()
+RenderState* Canvas::get_state()
 {
-    return m_scissor_y;
+    return m_state.get();
 }
 
-float Canvas::get_scissor_width()
+AtlasStats Canvas::get_atlas_stats()
 {
-    return m_scissor_width;
+    return m_atlas->get_stats();
 }
 
-float Canvas::get_scissor_height()
+ProgramCacheStats Canvas::get_shader_cache_stats()
 {
-    return m_scissor_height;
+    if (m_program_cache == nullptr)
+        return {};
+
+    return m_program_cache->get_stats();
 }
 
-float Canvas::get_viewport_x()
+ShapeCacheStats Canvas::get_shape_cache_stats()
 {
-    return m_viewport_x;
+    return m_shape_cache->get_stats();
 }
 
-float Canvas::get_viewport_y()
+GlyphAtlasStats Canvas::get_glyph_stats()
 {
-    return m_viewport_y;
+    return m_glyph_atlas->get_stats();
 }
 
-float Canvas::get_viewport_width()
+const CanvasStats& Canvas::get_stats()
 {
-    return m_viewport_width;
+    return m_stats;
 }
 
-float Canvas::get_viewport_height()
+template<typename T>
+void Canvas::submit(TexturePtr texture, ShaderPtr shader, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, const VertexTransform& transform, const fvec4& bounds)
 {
-    return m_viewport_height;
+    if (tracking())
+    {
+        auto hash = hash_value(transform, get_state_hash(texture, shader));
+        hash = hash_bytes(vertices, sizeof(VertexData) * vertex_count, hash);
+        track(hash_bytes(indices, sizeof(T) * index_count, hash), bounds);
+    }
+
+    if (!get_layer(texture, shader, bounds)->draw(texture, vertices, vertex_count, indices, index_count, transform))
+        split(texture, shader, vertices, vertex_count, indices, index_count, transform, bounds);
 }
 
-TexturePtr Canvas::create_texture(unsigned char* pixels, int32_t width, int32_t height, ColorFormat format)
+template<typename T>
+void Canvas::split(TexturePtr texture, ShaderPtr shader, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, const VertexTransform& transform, const fvec4& bounds)
 {
-    uint32_t texture;
-    glGenTextures(1, &texture);
-    CHECK_GL_ERROR;
-    glBindTexture(GL_TEXTURE_2D, texture);
-    CHECK_GL_ERROR;
+    m_split_vertices.clear();
+    m_split_indices.clear();
+    m_split_remap.assign(vertex_count, -1);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    CHECK_GL_ERROR;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    CHECK_GL_ERROR;
+    //fill up whatever is left of the current layer before starting new ones
+    auto* layer = get_layer(texture, shader, bounds);
+    for (size_t i = 0; i + 2 < index_count; i += 3)
+    {
+        int32_t missing = 0;
+        for (size_t j = 0; j < 3; j++)
+            missing += m_split_remap[indices[i + j]] == -1 ? 1 : 0;
 
-    //todo: actually use format
+        if (m_split_vertices.size() + missing > (size_t)layer->get_free_vertices() ||
+            m_split_indices.size() + 3 > (size_t)layer->get_free_indices())
+        {
+            layer->draw(texture, m_split_vertices.data(), m_split_vertices.size(), m_split_indices.data(), m_split_indices.size(), transform);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-    CHECK_GL_ERROR;
+            m_split_remap.assign(vertex_count, -1);
+            m_split_vertices.clear();
+            m_split_indices.clear();
 
-    TexturePtr p = NEW_3(Texture, texture, (float)width, (float)height);
-    m_textures[texture] = p;
+            layer = get_layer(texture, shader, bounds, true);
+        }
 
-    return p;
+        for (size_t j = 0; j < 3; j++)
+        {
+            auto index = indices[i + j];
+            if (m_split_remap[index] == -1)
+            {
+                m_split_remap[index] = (int32_t)m_split_vertices.size();
+                m_split_vertices.push_back(vertices[index]);
+            }
+
+            m_split_indices.push_back((uint32_t)m_split_remap[index]);
+        }
+    }
+
+    layer->draw(texture, m_split_vertices.data(), m_split_vertices.size(), m_split_indices.data(), m_split_indices.size(), transform);
 }
 
-TexturePtr Canvas::create_texture(string file)
+void Canvas::render_batches(const fmatrix4& projection, const ivec4* clip)
 {
-    FILE *fp = nullptr;
-    
-#ifdef _WIN32
-    fopen_s(&fp, file.c_str(), "rb");
-#else
-    fp = fopen(file.c_str(), "rb");
-#endif
-    
-    if (fp == nullptr)
-        return nullptr;
+    for (auto& batch : m_layers)
+    {
+        if (clip != nullptr && !batch->overlaps(fvec4(clip->x, clip->y, clip->x + clip->z, clip->y + clip->w)))
+            continue;
 
-    char header[8];
-    fread(header, 1, 8, fp);
+        auto mesh = batch->get_mesh();
+        if (batch->get_shader() != m_last_shader || mesh != nullptr)
+        {
+            m_last_shader = batch->get_shader();
 
-    if (png_sig_cmp((png_const_bytep)header, 0, 8))
-        return nullptr;
+            //FRAME_DATA_BLOCK shaders read it from the frame buffer, this only reaches shaders with a plain uniform
+            m_last_shader->set_uniform(UNIFORM_ID("projection"), projection);
 
-    auto png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    if (png_ptr == nullptr)
-        return nullptr;
+            if (mesh != nullptr)
+            {
+                auto texture = mesh->get_texture();
+                m_last_shader->set_uniform(UNIFORM_ID("model"), batch->get_model());
+                m_last_shader->set_uniform(UNIFORM_ID("tint"), batch->get_tint());
+                m_last_shader->set_uniform(UNIFORM_ID("region"), texture == nullptr ? fvec4(0.0f, 0.0f, 1.0f, 1.0f) : texture->get_region());
+            }
 
-    auto info_ptr = png_create_info_struct(png_ptr);
-    if (info_ptr == nullptr)
-    {
-        png_destroy_read_struct(&png_ptr, nullptr, nullptr);
-        return nullptr;
+            m_last_shader->apply();
+        }
+
+        //no base instance in GL 3.3, so the instance attributes get re-pointed per batch instead.
+        //meshes bind their own vertex array
+        if (batch->instanced())
+            bind_instances(batch->get_instance_offset());
+        else if (mesh == nullptr)
+            GLState::get()->bind_vertex_array(m_vao);
+
+        if (batch->get_index_count() > 0 || batch->get_instance_count() > 0 || mesh != nullptr)
+            m_stats.draw_calls++;
+
+        batch->render(clip);
     }
 
-    //todo: add error handlers
+    GLState::get()->bind_vertex_array(m_vao);
+}
 
-    png_init_io(png_ptr, fp);
-    png_set_sig_bytes(png_ptr, 8);
-    png_read_info(png_ptr, info_ptr);
+void Canvas::flush_recorders()
+{
+    lock_guard<mutex> lock(m_recorder_mutex);
+    if (m_replayed || m_recorders.empty())
+        return;
 
-    auto width = png_get_image_width(png_ptr, info_ptr);
-    auto height = png_get_image_height(png_ptr, info_ptr);
-    auto channels = png_get_channels(png_ptr, info_ptr);
+    //replay goes through the regular draw state, keep whatever the caller left behind
+    auto shader = m_shader;
+    auto depth = m_depth;
+    auto scissor = m_scissor;
+    auto scissor_rect = fvec4(m_scissor_x, m_scissor_y, m_scissor_width, m_scissor_height);
 
-    png_read_update_info(png_ptr, info_ptr);
+    for (auto& recorder : m_recorders)
+        replay(recorder.get());
 
-    auto tmp = png_get_rowbytes(png_ptr, info_ptr);
-    unsigned char* pixeldata = new unsigned char[height * tmp];
-    png_bytep* row_pointers = new png_bytep[height];
+    m_shader = shader;
+    m_depth = depth;
+    set_scissor(scissor, scissor_rect.x, scissor_rect.y, scissor_rect.z, scissor_rect.w);
 
-    for (size_t y = 0; y < height; y++)
-        row_pointers[y] = pixeldata + ((height - y - 1) * tmp);
+    m_replayed = true;
+}
 
-    png_read_image(png_ptr, row_pointers);
-    fclose(fp);
+void Canvas::replay(CommandRecorder* recorder)
+{
+    VertexTransform transform;
 
-    if (channels == 3)
+    for (auto& command : recorder->get_commands())
     {
-        unsigned char* pixeldata2 = new unsigned char[width * height * 4];
-        for (size_t y = 0; y < height; y++)
+        m_shader = command.shader;
+        m_depth = command.depth;
+        m_scissor = command.scissor;
+        m_scissor_x = command.scissor_x;
+        m_scissor_y = command.scissor_y;
+        m_scissor_width = command.scissor_width;
+        m_scissor_height = command.scissor_height;
+
+        //regions are read here on the context thread, a repack while recording doesn't leave stale uvs
+        auto region = command.texture == nullptr ? fvec4(0.0f, 0.0f, 1.0f, 1.0f) : command.texture->get_region();
+
+        auto bounds = clip_bounds(command.bounds);
+        if (command.sprite)
         {
-            for (size_t x = 0; x < width; x++)
+            auto instance = command.instance;
+            if (!command.line)
             {
-                pixeldata2[((y * width) + x) * 4 + 0] = pixeldata[((y * width) + x) * 3 + 0];
-                pixeldata2[((y * width) + x) * 4 + 1] = pixeldata[((y * width) + x) * 3 + 1];
-                pixeldata2[((y * width) + x) * 4 + 2] = pixeldata[((y * width) + x) * 3 + 2];
-                pixeldata2[((y * width) + x) * 4 + 3] = 255;
+                auto& source = command.source;
+                map_sprite_region(fvec4(region.x + source.x * region.z, region.y + source.y * region.w, source.z * region.z, source.w * region.w), instance);
             }
+
+            submit_sprite(command.texture, command.line ? m_default_line_shader : m_default_sprite_shader, instance, bounds);
+            continue;
         }
 
-        delete[] pixeldata;
-        pixeldata = pixeldata2;
+        //already transformed by the recorder, the identity transform maps uvs and assigns the texture slot
+        transform.region = region;
+        submit(command.texture, get_shader(command.texture), recorder->get_vertices(command.vertex_start), command.vertex_count,
+            recorder->get_indices(command.index_start), command.index_count, transform, bounds);
     }
+}
 
-    TexturePtr tex = create_texture(pixeldata, width, height);
+RenderLayer* Canvas::get_layer(TexturePtr texture, ShaderPtr shader, const fvec4& bounds, bool force)
+{
+    //geometry may join an earlier compatible layer as long as nothing drawn after
+    //that layer at the same depth overlaps it, otherwise blending order would change
+    if (!force)
+    {
+        int32_t lookback = 0;
+        for (auto it = m_layers.rbegin(); it != m_layers.rend() && lookback < MAX_BATCH_LOOKBACK; ++it, ++lookback)
+        {
+            auto& layer = *it;
+            if (layer->validate(texture, shader))
+            {
+                layer->extend(bounds);
+                return layer.get();
+            }
 
-    delete[] pixeldata;
-    delete[] row_pointers;
+            if (layer->get_depth() == m_depth && layer->overlaps(bounds))
+                break;
+        }
+    }
 
-    png_destroy_info_struct((png_structp)info_ptr, nullptr);
-    png_destroy_read_struct(&png_ptr, nullptr, nullptr);
+    if (!m_buffers.empty())
+    {
+        m_layers.push_back(move(m_buffers.back()));
+        m_buffers.pop_back();
+    }
+    else
+    {
+        m_layers.push_back(UNEW_4(RenderLayer, this, &m_vertex_arena, &m_index_arena, &m_instance_arena));
+    }
 
-    return tex;
+    auto& layer = m_layers.back();
+    layer->reset(texture, shader, shader == m_default_sprite_shader || shader == m_default_line_shader);
+    layer->extend(bounds);
+
+    return layer.get();
 }
 
-TexturePtr Canvas::create_texture(TextureID id)
+ShaderPtr Canvas::get_shader(TexturePtr texture)
 {
-    if (m_textures.find(id) == m_textures.end())
-        return nullptr;
+    //shaders still compiling draw with the defaults until they're ready
+    if (m_shader != nullptr && m_shader->ready())
+        return m_shader;
 
-    return m_textures[id];
+    return texture == nullptr ? m_default_geom_shader : m_default_shader;
 }
 
-ShaderPtr Canvas::create_shader(const string& vertex, const string& fragment)
+float Canvas::get_matrix_scale()
 {
-    auto vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    CHECK_GL_ERROR;
-
-    auto vsource = vertex.c_str();
-    int32_t vlength = (int32_t)vertex.length();
+    //the larger axis so the tolerance holds in every direction
+    auto& matrix = m_state->matrix();
+    return max(glm::length(fvec2(matrix[0].x, matrix[0].y)), glm::length(fvec2(matrix[1].x, matrix[1].y)));
+}
 
-    glShaderSource(vertex_shader, 1, &vsource, &vlength);
-    CHECK_GL_ERROR;
-    glCompileShader(vertex_shader);
-    CHECK_GL_ERROR;
+fvec4 Canvas::get_bounds(const vector<VertexData>& vertices, bool flipped_y)
+{
+    if (vertices.empty())
+        return fvec4();
 
-    int32_t success = 0;
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    CHECK_GL_ERROR;
+    float min_x = FLT_MAX;
+    float min_y = FLT_MAX;
+    float max_x = -FLT_MAX;
+    float max_y = -FLT_MAX;
 
-    if (success == GL_FALSE)
+    for (auto& vertex : vertices)
     {
-        int32_t logSize = 0;
-        glGetShaderiv(vertex_shader, GL_INFO_LOG_LENGTH, &logSize);
-        CHECK_GL_ERROR;
-
-        static char log[2048];
-        memset(log, 0, 2048);
-
-        glGetShaderInfoLog(vertex_shader, 2048, &logSize, log);
-        CHECK_GL_ERROR;
-        glDeleteShader(vertex_shader);
-        CHECK_GL_ERROR;
-
-        LogSystem::get()->err("Failed to vertex shader: %s", log);
-        return nullptr;
+        min_x = min(min_x, vertex.v.x);
+        min_y = min(min_y, vertex.v.y);
+        max_x = max(max_x, vertex.v.x);
+        max_y = max(max_y, vertex.v.y);
     }
 
-    auto fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    CHECK_GL_ERROR;
-
-    auto fsource = fragment.c_str();
-    int32_t flength = (int32_t)fragment.length();
-
-    glShaderSource(fragment_shader, 1, &fsource, &flength);
-    CHECK_GL_ERROR;
-    glCompileShader(fragment_shader);
-    CHECK_GL_ERROR;
+    return get_bounds(m_state->matrix(), fvec4(min_x, min_y, max_x, max_y), flipped_y);
+}
 
-    success = 0;
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    CHECK_GL_ERROR;
+fvec4 Canvas::get_bounds(const fmatrix4& transform, const fvec4& local, bool flipped_y)
+{
+    fvec2 corners[4] = {
+        fvec2(local.x, local.y), fvec2(local.z, local.y),
+        fvec2(local.x, local.w), fvec2(local.z, local.w)
+    };
 
-    if (success == GL_FALSE)
+    fvec4 bounds(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (auto& corner : corners)
     {
-        int32_t logSize = 0;
-        glGetShaderiv(fragment_shader, GL_INFO_LOG_LENGTH, &logSize);
-        CHECK_GL_ERROR;
+        float x = transform[0][0] * corner.x + transform[1][0] * corner.y + transform[3][0];
+        float y = transform[0][1] * corner.x + transform[1][1] * corner.y + transform[3][1];
 
-        static char log[2048];
-        memset(log, 0, 2048);
-
-        glGetShaderInfoLog(fragment_shader, 2048, &logSize, log);
-        CHECK_GL_ERROR;
-        glDeleteShader(vertex_shader);
-        CHECK_GL_ERROR;
-        glDeleteShader(fragment_shader);
-        CHECK_GL_ERROR;
+        if (flipped_y)
+            y = m_viewport_height - y;
 
-        LogSystem::get()->err("Failed to fragment shader: %s", log);
-        return nullptr;
+        bounds.x = min(bounds.x, x);
+        bounds.y = min(bounds.y, y);
+        bounds.z = max(bounds.z, x);
+        bounds.w = max(bounds.w, y);
     }
 
-    uint32_t program = glCreateProgram();
-    CHECK_GL_ERROR;
-    glAttachShader(program, vertex_shader);
-    CHECK_GL_ERROR;
-    glAttachShader(program, fragment_shader);
-    CHECK_GL_ERROR;
-
-    glBindAttribLocation(program, 0, "position");
-    CHECK_GL_ERROR;
-    glBindAttribLocation(program, 1, "color");
-    CHECK_GL_ERROR;
-    glBindAttribLocation(program, 2, "texcoord");
-    CHECK_GL_ERROR;
-
-    glLinkProgram(program);
-    CHECK_GL_ERROR;
+    return clip_bounds(bounds);
+}
 
-    success = 0;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    CHECK_GL_ERROR;
+bool Canvas::tracking()
+{
+    return m_damage_tracking || m_idle_detection;
+}
 
-    if (success == GL_FALSE)
-    {
-        int32_t maxLength = 0;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
-        CHECK_GL_ERROR;
+void Canvas::track(uint64_t hash, const fvec4& bounds)
+{
+    m_frame_hash = hash_value(hash, m_frame_hash);
 
-        static char log[2048];
-        memset(log, 0, 2048);
+    if (m_damage_tracking)
+        m_damage->track(hash, bounds);
+}
 
-        glGetProgramInfoLog(program, 2048, &maxLength, log);
-        CHECK_GL_ERROR;
-        glDeleteProgram(program);
-        CHECK_GL_ERROR;
-        glDeleteShader(vertex_shader);
-        CHECK_GL_ERROR;
-        glDeleteShader(fragment_shader);
-        CHECK_GL_ERROR;
+uint64_t Canvas::get_state_hash(TexturePtr texture, ShaderPtr shader)
+{
+    auto hash = hash_value(texture == nullptr ? (TextureID)0 : texture->get_id());
+    hash = hash_value(shader.get(), hash_value(m_depth, hash));
 
-        LogSystem::get()->err("Failed to link shader: %s", log);
-        return nullptr;
+    //a frame that only changes uniform values still has to be drawn, as does one that only moves
+    //time forward for a shader reading it. m_last_counter differs every frame
+    if (shader != nullptr)
+    {
+        hash = hash_value(shader->get_uniform_hash(), hash);
+        if (shader->is_animated())
+            hash = hash_value(m_last_counter, hash);
     }
-    
-    glDetachShader(program, vertex_shader);
-    CHECK_GL_ERROR;
-    glDetachShader(program, fragment_shader);
-    CHECK_GL_ERROR;
 
-    return NEW_1(Shader, program);
+    if (m_scissor)
+        hash = hash_value(fvec4(m_scissor_x, m_scissor_y, m_scissor_width, m_scissor_height), hash);
+
+    return hash;
 }
 
-RenderState* Canvas::get_state()
+fmatrix4 Canvas::get_base_matrix()
 {
-    return m_state.get();
+    fmatrix4 mat;
+    return glm::scale(mat, fvec3(m_viewport_scale_x, m_viewport_scale_y, 1.0f));
 }
 
-RenderLayer* Canvas::get_layer(TexturePtr texture, bool force)
+fvec4 Canvas::clip_bounds(const fvec4& bounds)
 {
-    ShaderPtr shader = m_shader;
-    if (shader == nullptr)
-    {
-        if (texture == nullptr)
-            shader = m_default_geom_shader;
-        else
-            shader = m_default_shader;
-    }
+    if (!m_scissor)
+        return bounds;
 
-    if (m_layers.empty() || !m_layers.back()->validate(texture, shader) || force)
-    {
-        if (!m_buffers.empty())
-        {
-            auto& layer = m_buffers[0];
-            layer->reset(texture, shader);
+    return fvec4(max(bounds.x, m_scissor_x), max(bounds.y, m_scissor_y),
+        min(bounds.z, m_scissor_x + m_scissor_width), min(bounds.w, m_scissor_y + m_scissor_height));
+}
 
-            m_layers.push_back(move(layer));
-            m_buffers.erase(m_buffers.begin());
+void Canvas::draw_sprite(TexturePtr texture, float dx, float dy, float dw, float dh, bool flipped_y)
+{
+    VertexTransform transform(m_state.get(), texture, flipped_y, m_viewport_height);
 
-            return m_layers.back().get();
-        }
-        else
-        {
-            uint32_t buffers[2];
-            glGenBuffers(2, buffers);
-            CHECK_GL_ERROR;
+    SpriteInstance instance;
+    transform_sprite(transform, dx, dy, dw, dh, instance);
+    submit_sprite(texture, m_default_sprite_shader, instance, clip_bounds(get_sprite_bounds(instance)));
+}
 
-            m_layers.push_back(UNEW_3(RenderLayer, this, buffers[0], buffers[1]));
+void Canvas::submit_sprite(TexturePtr texture, ShaderPtr shader, const SpriteInstance& instance, const fvec4& bounds)
+{
+    if (tracking())
+        track(hash_value(instance, get_state_hash(texture, shader)), bounds);
 
-            auto& layer = m_layers.back();
-            layer->reset(texture, shader);
+    if (!get_layer(texture, shader, bounds)->draw(texture, instance))
+        get_layer(texture, shader, bounds, true)->draw(texture, instance);
+}
 
-            return layer.get();
-        }
-    }
+void Canvas::bind_instances(size_t offset)
+{
+    GLState::get()->bind_vertex_array(m_sprite_vao);
+    GLState::get()->bind_buffer(GL_ARRAY_BUFFER, m_instance_stream->get_buffer());
 
-    return m_layers.back().get();
+#define OFFSETOF(TYPE, ELEMENT) (GLvoid*)(offset + (size_t)&(((TYPE *)0)->ELEMENT))
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), OFFSETOF(SpriteInstance, axis_x));
+    CHECK_GL_ERROR;
+    glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), OFFSETOF(SpriteInstance, axis_y));
+    CHECK_GL_ERROR;
+    glVertexAttribPointer(6, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), OFFSETOF(SpriteInstance, origin));
+    CHECK_GL_ERROR;
+    glVertexAttribPointer(7, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(SpriteInstance), OFFSETOF(SpriteInstance, region));
+    CHECK_GL_ERROR;
+    glVertexAttribPointer(8, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteInstance), OFFSETOF(SpriteInstance, color));
+    CHECK_GL_ERROR;
+    glVertexAttribIPointer(9, 1, GL_UNSIGNED_INT, sizeof(SpriteInstance), OFFSETOF(SpriteInstance, slot));
+    CHECK_GL_ERROR;
+#undef OFFSETOF
 }
 
 RenderState::RenderState() : m_opacity(), m_colors(), m_matrices()
@@ -5,6 +5,11 @@
 #include "Texture.h"
 #include "Color.h"
 #include "Shader.h"
+#include "Arena.h"
+#include "TextureAtlas.h"
+#include "ProgramCache.h"
+#include "Path.h"
+#include "Font.h"
 
 enum class ColorFormat
 {
@@ -19,33 +24,62 @@ struct VertexData
     fvec2 v;
     fvec2 uv;
     uint32_t color;
+    uint32_t slot;
 
     VertexData() :
-        v(), uv(), color(0xFFFFFFFF)
+        v(), uv(), color(0xFFFFFFFF), slot(0)
     {
     }
 
     VertexData(const fvec2& _v, const fvec2& _uv, uint32_t _c) :
-        v(_v), uv(_uv), color(_c)
+        v(_v), uv(_uv), color(_c), slot(0)
     {
     }
 
     VertexData(const fvec2& p) :
-        v(p), uv(), color(0xFFFFFFFF)
+        v(p), uv(), color(0xFFFFFFFF), slot(0)
     {
     }
 
     VertexData(const fvec2& p, const fvec2& t) :
-        v(p), uv(t), color(0xFFFFFFFF)
+        v(p), uv(t), color(0xFFFFFFFF), slot(0)
     {
     }
 
     VertexData(const fvec2& p, const fvec2& t, const Color& col) :
-        v(p), uv(t), color(col.uint)
+        v(p), uv(t), color(col.uint), slot(0)
     {
     }
 };
 
+//Per-sprite data for the instanced quad path, the unit quad corner c is
+//placed at origin + axis_x * c.x + axis_y * c.y and samples region.xy + c * region.zw
+struct SpriteInstance
+{
+    fvec2 axis_x;
+    fvec2 axis_y;
+    fvec2 origin;
+    uint16_t region[4];
+    uint32_t color;
+    uint32_t slot;
+};
+
+struct CanvasStats
+{
+    int32_t batches;
+    int32_t draw_calls;
+    int32_t vertices;
+    int32_t indices;
+    int32_t instances;
+    int32_t damage_rects;
+    float redrawn_area;
+    int32_t avoided_calls;
+};
+
+using VertexArena = Arena<VertexData>;
+using IndexArena = Arena<uint32_t>;
+using InstanceArena = Arena<SpriteInstance>;
+
 class RenderState
 {
 private:
@@ -71,22 +105,102 @@ public:
 };
 
 class RenderLayer;
+class StreamBuffer;
+class CommandRecorder;
+class DamageTracker;
+class UniformBuffer;
+class ShapeCache;
+struct ShapeMesh;
+struct ShapeCacheStats;
+class GlyphAtlas;
+struct GlyphAtlasStats;
+struct VertexTransform;
 using RenderLayerPtr = UPTR(RenderLayer);
 using RenderStatePtr = UPTR(RenderState);
+using StreamBufferPtr = UPTR(StreamBuffer);
+using TextureAtlasPtr = UPTR(TextureAtlas);
+using CommandRecorderPtr = UPTR(CommandRecorder);
+using DamageTrackerPtr = UPTR(DamageTracker);
+using UniformBufferPtr = UPTR(UniformBuffer);
+using ProgramCachePtr = UPTR(ProgramCache);
+using ShapeCachePtr = UPTR(ShapeCache);
+using GlyphAtlasPtr = UPTR(GlyphAtlas);
 
 class Canvas
 {
 private:
+    //program linking in the background, see create_shader_async
+    struct PendingShader
+    {
+        ShaderPtr shader;
+        string vertex;
+        string fragment;
+        uint32_t program;
+        uint32_t vertex_shader;
+        uint32_t fragment_shader;
+        uint64_t start;
+    };
+
+    static const int32_t MAX_BATCH_LOOKBACK = 32;
+    static constexpr float LOD_TOLERANCE = 0.5f;
+    static constexpr float PATH_TOLERANCE = 0.25f;
+
     vector<RenderLayerPtr> m_layers;
     vector<RenderLayerPtr> m_buffers;
+    VertexArena m_vertex_arena;
+    IndexArena m_index_arena;
+    InstanceArena m_instance_arena;
+    vector<CommandRecorderPtr> m_recorders;
+    mutex m_recorder_mutex;
+
+    DamageTrackerPtr m_damage;
+    bool m_damage_tracking;
+    int32_t m_buffer_age;
+    vector<ivec4> m_damage_rects;
+
+    bool m_idle_detection;
+    bool m_invalidated;
+    bool m_replayed;
+    uint64_t m_frame_hash;
+    uint64_t m_last_frame_hash;
     unordered_map<TextureID, TexturePtr> m_textures;
+    TextureAtlasPtr m_atlas;
+    ProgramCachePtr m_program_cache;
+    ShapeCachePtr m_shape_cache;
+    GlyphAtlasPtr m_glyph_atlas;
+    vector<PendingShader> m_pending_shaders;
+    vector<fvec2> m_lod_points;
+    vector<VertexData> m_fill_vertices;
+    vector<uint32_t> m_fill_indices;
+    vector<VertexData> m_split_vertices;
+    vector<uint32_t> m_split_indices;
+    vector<int32_t> m_split_remap;
+    vector<SpriteInstance> m_line_instances;
+    vector<vector<VertexData>> m_text_vertices;
+    vector<uint32_t> m_text_indices;
+    bool m_parallel_compile;
+    bool m_atlas_enabled;
+    bool m_antialiasing;
 
     RenderStatePtr m_state;
+    StreamBufferPtr m_vertex_stream;
+    StreamBufferPtr m_index_stream;
+    StreamBufferPtr m_instance_stream;
+    UniformBufferPtr m_frame_buffer;
+    uint64_t m_start_counter;
+    uint64_t m_last_counter;
 
     ShaderPtr m_default_shader;
     ShaderPtr m_default_geom_shader;
+    ShaderPtr m_default_sprite_shader;
+    ShaderPtr m_default_line_shader;
+    ShaderPtr m_default_static_shader;
+    ShaderPtr m_default_static_geom_shader;
+    ShaderPtr m_default_sdf_shader;
     int32_t m_vertex_attribute;
     int32_t m_color_attribute;
+    int32_t m_slot_attribute;
+    CanvasStats m_stats;
 
     Color m_clear_color;
     float m_viewport_scale_x;
@@ -101,11 +215,16 @@ private:
     float m_scissor_width;
     float m_scissor_height;
     bool m_scissor;
+    int32_t m_depth;
 
     ShaderPtr m_shader;
     ShaderPtr m_last_shader;
 
     uint32_t m_vao;
+    uint32_t m_vertex_generation;
+    uint32_t m_index_generation;
+    uint32_t m_sprite_vao;
+    uint32_t m_quad_buffers[2];
     bool m_setup;
 public:
     Canvas();
@@ -115,23 +234,68 @@ public:
 
     void begin();
 
+    //lines are expanded on the gpu with round caps and an antialiased edge, strength is half the width.
+    //With a custom shader set they're tessellated into regular vertex data instead
     void draw_line(float x1, float y1, float x2, float y2, float strength = 0.6f);
+    //polylines with more points than pixels they cross are decimated first, see LineSeries
     void draw_polyline(const vector<fvec2>& points, bool closed = false, float strength = 0.6f);
+    void draw(LineSeriesPtr series, float strength = 0.6f);
+    //curves are flattened to within a quarter pixel at the current matrix's scale
+    void stroke_path(PathPtr path, float strength = 0.6f);
+    //simple paths are triangulated once and batch like any other geometry, paths with holes or
+    //crossings are filled with stencil-then-cover in a layer of their own
+    void fill_path(PathPtr path, FillRule rule = FillRule::NonZero);
+
+    //primitives come out of a cache of prebuilt meshes, see ShapeCache
+    void draw_circle(float x, float y, float radius);
+    //ring segment of the given thickness inside radius, angles in radians
+    void draw_arc(float x, float y, float radius, float start, float end, float thickness);
+    void draw_rounded_rect(float x, float y, float w, float h, float radius);
+    //borders are in texture pixels and keep their size, the center stretches to fill the rest
+    void draw_nine_slice(TexturePtr texture, float left, float top, float right, float bottom, float x, float y, float w, float h);
+    //utf-8 text with its first baseline ascent below y, size is the line height in pixels. Glyphs come
+    //out of a shared atlas so a whole run usually ends up in a single batch
+    void draw_text(FontPtr font, const string& text, float x, float y, float size, bool flipped_y = false);
+    fvec2 measure_text(FontPtr font, const string& text, float size);
 
     void draw(const vector<VertexData>& vertices, const vector<uint16_t>& indices, bool flipped_y = false);
+    void draw(const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y = false);
     void draw(float x, float y, float w, float h, bool flipped_y = false);
     void draw(float sx, float sy, float sw, float sh, float dx, float dy, bool flipped_y = false);
     void draw(float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y = false);
     void draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<unsigned short>& indices, bool flipped_y = false);
+    void draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y = false);
     void draw(TexturePtr texture, float x, float y, float w, float h, bool flipped_y = false);
     void draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, bool flipped_y = false);
     void draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y = false);
+    void draw(StaticMeshPtr mesh);
     void end();
 
     void set_clear_color(const Color& color);
     void set_viewport(float x, float y, float w, float h);
     void set_viewport_scaling(float x, float y);
     void set_scissor(bool enabled, float x = 0.0f, float y = 0.0f, float w = 0.0f, float h = 0.0f);
+    void set_depth(int32_t depth);
+    //small textures created afterwards are packed into shared pages so they can batch together, off by
+    //default since their uvs then cover a sub-region which breaks wrapping and shaders expecting 0..1
+    void set_texture_atlas(bool enabled);
+    //feathers the edges of filled paths and shapes with a one pixel coverage fringe, on by default
+    void set_antialiasing(bool enabled);
+    //frames are redrawn in full until the swap chain's real buffer age is passed to set_buffer_age
+    //before each end(), as reported by EGL_EXT_buffer_age or GLX_EXT_buffer_age. 0 means undefined contents
+    void set_damage_tracking(bool enabled);
+    void set_buffer_age(int32_t age);
+    void set_idle_detection(bool enabled);
+    //linked programs are kept in this directory and reused on later launches, call before setup()
+    //to include the default shaders. An empty path disables the cache
+    void set_shader_cache(const string& directory);
+    void set_shape_cache_budget(size_t bytes);
+    void invalidate();
+    //whether the frame recorded since begin() differs from the last one passed to end(), when
+    //it doesn't both end() and the swap can be skipped. Shaders reading time or delta_time from
+    //FrameData count as changed every frame, anything else animated outside the canvas needs
+    //invalidate(). Always true without idle detection
+    bool frame_changed();
     void set_shader(ShaderPtr shader);
     bool scissor_test();
 
@@ -139,6 +303,7 @@ public:
     float get_scissor_y();
     float get_scissor_width();
     float get_scissor_height();
+    int32_t get_depth();
 
     float get_viewport_x();
     float get_viewport_y();
@@ -149,10 +314,51 @@ public:
     TexturePtr create_texture(string file);
     TexturePtr create_texture(TextureID id);
     ShaderPtr create_shader(const string& vertex, const string& fragment);
+    FontPtr create_font(const string& file, GlyphMode mode = GlyphMode::Bitmap);
+    FontPtr create_font(const uint8_t* data, size_t size, GlyphMode mode = GlyphMode::Bitmap);
+    //returns right away, the shader becomes ready() in a later begin() once the driver finished linking
+    ShaderPtr create_shader_async(const string& vertex, const string& fragment);
+    StaticMeshPtr create_static_mesh(TexturePtr texture = nullptr);
+    //safe to call from any thread, the recorder is used by that thread only
+    CommandRecorder* create_recorder();
 
     RenderState* get_state();
+    AtlasStats get_atlas_stats();
+    ProgramCacheStats get_shader_cache_stats();
+    ShapeCacheStats get_shape_cache_stats();
+    GlyphAtlasStats get_glyph_stats();
+    const CanvasStats& get_stats();
 private:
-    RenderLayer* get_layer(TexturePtr texture, bool force = false);
+    RenderLayer* get_layer(TexturePtr texture, ShaderPtr shader, const fvec4& bounds, bool force = false);
+    ShaderPtr get_shader(TexturePtr texture);
+    fvec4 get_bounds(const vector<VertexData>& vertices, bool flipped_y);
+    fvec4 get_bounds(const fmatrix4& transform, const fvec4& local, bool flipped_y);
+    fvec4 clip_bounds(const fvec4& bounds);
+    uint64_t get_state_hash(TexturePtr texture, ShaderPtr shader);
+    bool tracking();
+    void track(uint64_t hash, const fvec4& bounds);
+    fmatrix4 get_base_matrix();
+    float get_matrix_scale();
+
+    void draw_sprite(TexturePtr texture, float dx, float dy, float dw, float dh, bool flipped_y);
+    void draw_shape(TexturePtr texture, const ShapeMesh& mesh, const fmatrix4& local);
+    void feather_path(PathPtr path, float width);
+    void submit_sprite(TexturePtr texture, ShaderPtr shader, const SpriteInstance& instance, const fvec4& bounds);
+    void stroke_polyline(const vector<fvec2>& points, bool closed, float strength);
+    void tessellate_polyline(const vector<fvec2>& points, bool closed, float strength);
+    void bind_instances(size_t offset);
+    void flush_recorders();
+    void replay(CommandRecorder* recorder);
+    void render_batches(const fmatrix4& projection, const ivec4* clip);
+    uint32_t compile_program(const string& vertex, const string& fragment);
+    uint32_t link_program(const string& vertex, const string& fragment, uint32_t& vertex_shader, uint32_t& fragment_shader);
+    bool finish_program(uint32_t program, uint32_t vertex_shader, uint32_t fragment_shader);
+    void poll_shaders();
+
+    template<typename T>
+    void submit(TexturePtr texture, ShaderPtr shader, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, const VertexTransform& transform, const fvec4& bounds);
+    template<typename T>
+    void split(TexturePtr texture, ShaderPtr shader, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, const VertexTransform& transform, const fvec4& bounds);
 };
 
 #endif
@@ -0,0 +1,242 @@
+#include "CommandRecorder.h"
+#include "Polyline.h"
+#include "VertexKernel.h"
+
+CommandRecorder::CommandRecorder(Canvas* canvas) :
+    m_canvas(canvas), m_state(move(UNEW_0(RenderState))), m_viewport_height(0.0f), m_vertex_arena(), m_index_arena(), m_commands(),
+    m_shader(), m_depth(0), m_scissor(false), m_scissor_x(), m_scissor_y(), m_scissor_width(), m_scissor_height()
+{
+}
+
+CommandRecorder::~CommandRecorder()
+{
+}
+
+void CommandRecorder::reset(const fmatrix4& base, float viewport_height)
+{
+    m_viewport_height = viewport_height;
+    m_commands.clear();
+    m_vertex_arena.reset();
+    m_index_arena.reset();
+
+    m_shader = nullptr;
+    m_depth = 0;
+    m_scissor = false;
+
+    m_state->reset();
+    m_state->push_matrix(base);
+}
+
+void CommandRecorder::draw_line(float x1, float y1, float x2, float y2, float strength)
+{
+    if (m_shader != nullptr)
+    {
+        draw_polyline({ fvec2(x1, y1), fvec2(x2, y2) }, false, strength);
+        return;
+    }
+
+    VertexTransform transform(m_state.get(), nullptr, false, m_viewport_height);
+    record_line(transform, fvec2(x1, y1), fvec2(x2, y2), strength);
+}
+
+void CommandRecorder::draw_polyline(const vector<fvec2>& points, bool closed, float strength)
+{
+    //same rule as the canvas, only custom shaders get tessellated lines
+    if (m_shader == nullptr)
+    {
+        if (points.size() < 2)
+            return;
+
+        VertexTransform transform(m_state.get(), nullptr, false, m_viewport_height);
+
+        auto first = m_commands.size();
+        auto segments = closed && points.size() > 2 ? points.size() : points.size() - 1;
+        for (size_t i = 0; i < segments; i++)
+        {
+            record_line(transform, points[i], points[(i + 1) % points.size()], strength);
+
+            if (i > 0)
+                join_lines(m_commands[first + i - 1].instance, m_commands[first + i].instance);
+        }
+
+        if (closed && segments > 2)
+            join_lines(m_commands[first + segments - 1].instance, m_commands[first].instance);
+
+        return;
+    }
+
+    auto pieces = polyline_pieces(points.size(), closed);
+    if (pieces == 0)
+        return;
+
+    VertexTransform transform(m_state.get(), nullptr, false, m_viewport_height);
+
+    auto command = create_command(nullptr);
+    command.vertex_count = (int32_t)polyline_vertices(points.size(), pieces);
+    command.index_count = (int32_t)polyline_indices(points.size(), pieces);
+    command.vertex_start = m_vertex_arena.allocate(command.vertex_count);
+    command.index_start = m_index_arena.allocate(command.index_count);
+
+    auto* vertices = m_vertex_arena.data(command.vertex_start);
+    polyline(points.data(), points.size(), closed, strength, 0, pieces, vertices, m_index_arena.data(command.index_start));
+    transform_vertices(transform, vertices, vertices, command.vertex_count);
+    command.bounds = get_vertex_bounds(vertices, command.vertex_count);
+
+    m_commands.push_back(command);
+}
+
+void CommandRecorder::draw(const vector<VertexData>& vertices, const vector<uint16_t>& indices, bool flipped_y)
+{
+    record(nullptr, vertices.data(), vertices.size(), indices.data(), indices.size(), flipped_y);
+}
+
+void CommandRecorder::draw(const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y)
+{
+    record(nullptr, vertices.data(), vertices.size(), indices.data(), indices.size(), flipped_y);
+}
+
+void CommandRecorder::draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<uint16_t>& indices, bool flipped_y)
+{
+    record(texture, vertices.data(), vertices.size(), indices.data(), indices.size(), flipped_y);
+}
+
+void CommandRecorder::draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y)
+{
+    record(texture, vertices.data(), vertices.size(), indices.data(), indices.size(), flipped_y);
+}
+
+void CommandRecorder::draw(TexturePtr texture, float x, float y, float w, float h, bool flipped_y)
+{
+    if (texture == nullptr)
+        draw(texture, 0.0f, 0.0f, w, h, x, y, w, h, flipped_y);
+    else
+        draw(texture, 0.0f, 0.0f, (float)texture->get_width(), (float)texture->get_height(), x, y, w, h, flipped_y);
+}
+
+void CommandRecorder::draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y)
+{
+    //the source rect in uv space, untextured draws sample nothing
+    fvec4 source(0.0f, 0.0f, 1.0f, 1.0f);
+    if (texture != nullptr && texture->get_width() > 0 && texture->get_height() > 0)
+    {
+        auto tw = texture->get_width();
+        auto th = texture->get_height();
+        source = fvec4(sx / tw, sy / th, sw / tw, sh / th);
+    }
+
+    //same rule as the canvas, custom shaders expect regular vertex data
+    if (texture != nullptr && m_shader == nullptr)
+    {
+        //the texture's region is only read on replay
+        VertexTransform transform(m_state.get(), nullptr, flipped_y, m_viewport_height);
+
+        auto command = create_command(texture);
+        command.sprite = true;
+        command.source = source;
+        transform_sprite(transform, dx, dy, dw, dh, command.instance);
+        command.bounds = get_sprite_bounds(command.instance);
+
+        m_commands.push_back(command);
+        return;
+    }
+
+    VertexData vertices[4];
+    vertices[0].v = fvec2(dx, dy);           vertices[0].uv = fvec2(source.x, source.y);
+    vertices[1].v = fvec2(dx + dw, dy);      vertices[1].uv = fvec2(source.x + source.z, source.y);
+    vertices[2].v = fvec2(dx + dw, dy + dh); vertices[2].uv = fvec2(source.x + source.z, source.y + source.w);
+    vertices[3].v = fvec2(dx, dy + dh);      vertices[3].uv = fvec2(source.x, source.y + source.w);
+
+    static const uint16_t indices[6] = { 0, 1, 2, 2, 3, 0 };
+    record(texture, vertices, 4, indices, 6, flipped_y);
+}
+
+void CommandRecorder::set_scissor(bool enabled, float x, float y, float w, float h)
+{
+    m_scissor = enabled;
+    m_scissor_x = x;
+    m_scissor_y = y;
+    m_scissor_width = w;
+    m_scissor_height = h;
+}
+
+void CommandRecorder::set_depth(int32_t depth)
+{
+    m_depth = depth;
+}
+
+void CommandRecorder::set_shader(ShaderPtr shader)
+{
+    m_shader = shader;
+}
+
+RenderState* CommandRecorder::get_state()
+{
+    return m_state.get();
+}
+
+const vector<RecordedCommand>& CommandRecorder::get_commands()
+{
+    return m_commands;
+}
+
+const VertexData* CommandRecorder::get_vertices(size_t offset)
+{
+    return m_vertex_arena.data(offset);
+}
+
+const uint32_t* CommandRecorder::get_indices(size_t offset)
+{
+    return m_index_arena.data(offset);
+}
+
+template<typename T>
+void CommandRecorder::record(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, bool flipped_y)
+{
+    if (vertex_count == 0 || index_count == 0)
+        return;
+
+    VertexTransform transform(m_state.get(), nullptr, flipped_y, m_viewport_height);
+
+    auto command = create_command(texture);
+    command.vertex_start = m_vertex_arena.allocate(vertex_count);
+    command.index_start = m_index_arena.allocate(index_count);
+    command.vertex_count = (int32_t)vertex_count;
+    command.index_count = (int32_t)index_count;
+
+    auto* target = m_vertex_arena.data(command.vertex_start);
+    transform_vertices(transform, vertices, target, vertex_count);
+    command.bounds = get_vertex_bounds(target, vertex_count);
+
+    auto* index_data = m_index_arena.data(command.index_start);
+    for (size_t i = 0; i < index_count; i++)
+        index_data[i] = indices[i];
+
+    m_commands.push_back(command);
+}
+
+void CommandRecorder::record_line(const VertexTransform& transform, const fvec2& a, const fvec2& b, float strength)
+{
+    auto command = create_command(nullptr);
+    command.sprite = true;
+    command.line = true;
+    transform_line(transform, a.x, a.y, b.x, b.y, strength, command.instance);
+    command.bounds = get_line_bounds(command.instance);
+
+    m_commands.push_back(command);
+}
+
+RecordedCommand CommandRecorder::create_command(TexturePtr texture)
+{
+    RecordedCommand command = {};
+    command.texture = texture;
+    command.shader = m_shader;
+    command.depth = m_depth;
+    command.scissor = m_scissor;
+    command.scissor_x = m_scissor_x;
+    command.scissor_y = m_scissor_y;
+    command.scissor_width = m_scissor_width;
+    command.scissor_height = m_scissor_height;
+    command.source = fvec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    return command;
+}
@@ -0,0 +1,84 @@
+#ifndef _COMMAND_RECORDER_H_
+#define _COMMAND_RECORDER_H_
+
+#include "Config.h"
+#include "Canvas.h"
+
+struct RecordedCommand
+{
+    TexturePtr texture;
+    ShaderPtr shader;
+    int32_t depth;
+    bool scissor;
+    float scissor_x;
+    float scissor_y;
+    float scissor_width;
+    float scissor_height;
+    fvec4 bounds;
+
+    bool sprite;
+    bool line;
+    //part of the texture a sprite samples as x, y, w, h in 0-1 of the texture's region
+    fvec4 source;
+    SpriteInstance instance;
+    size_t vertex_start;
+    size_t index_start;
+    int32_t vertex_count;
+    int32_t index_count;
+};
+
+//Records draws from a single worker thread, vertices are transformed and
+//tessellated while recording so only the copy into layers is left for Canvas::end().
+//Recorders are merged in creation order after everything drawn on the canvas directly.
+//Textures and shaders still have to be created on the context thread. The viewport is
+//captured when the frame begins and uvs are mapped into atlas regions on replay, so
+//neither a resize nor an atlas repack on the context thread races with recording.
+class CommandRecorder
+{
+private:
+    Canvas* m_canvas;
+    RenderStatePtr m_state;
+    float m_viewport_height;
+    VertexArena m_vertex_arena;
+    IndexArena m_index_arena;
+    vector<RecordedCommand> m_commands;
+
+    ShaderPtr m_shader;
+    int32_t m_depth;
+    bool m_scissor;
+    float m_scissor_x;
+    float m_scissor_y;
+    float m_scissor_width;
+    float m_scissor_height;
+public:
+    CommandRecorder(Canvas* canvas);
+    ~CommandRecorder();
+
+    void reset(const fmatrix4& base, float viewport_height);
+
+    void draw_line(float x1, float y1, float x2, float y2, float strength = 0.6f);
+    void draw_polyline(const vector<fvec2>& points, bool closed = false, float strength = 0.6f);
+
+    void draw(const vector<VertexData>& vertices, const vector<uint16_t>& indices, bool flipped_y = false);
+    void draw(const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y = false);
+    void draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<uint16_t>& indices, bool flipped_y = false);
+    void draw(TexturePtr texture, const vector<VertexData>& vertices, const vector<uint32_t>& indices, bool flipped_y = false);
+    void draw(TexturePtr texture, float x, float y, float w, float h, bool flipped_y = false);
+    void draw(TexturePtr texture, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh, bool flipped_y = false);
+
+    void set_scissor(bool enabled, float x = 0.0f, float y = 0.0f, float w = 0.0f, float h = 0.0f);
+    void set_depth(int32_t depth);
+    void set_shader(ShaderPtr shader);
+
+    RenderState* get_state();
+    const vector<RecordedCommand>& get_commands();
+    const VertexData* get_vertices(size_t offset);
+    const uint32_t* get_indices(size_t offset);
+private:
+    template<typename T>
+    void record(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, bool flipped_y);
+    RecordedCommand create_command(TexturePtr texture);
+    void record_line(const VertexTransform& transform, const fvec2& a, const fvec2& b, float strength);
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <array>
 #include <unordered_map>
 #include <chrono>
+#include <mutex>
 #include <string>
 #include <stdarg.h>
 #include <glad/glad.h>
@@ -48,24 +49,34 @@ using TimePoint = chrono::time_point<chrono::steady_clock>;
 using TimeDelta = chrono::nanoseconds;
 
 class Canvas;
+class GLState;
 class GUI;
 class Input;
 class LogSystem;
 class Shader;
+class StaticMesh;
+class LineSeries;
+class Path;
 class Texture;
 class Window;
 class IEvent;
 class EventHandler;
+class Font;
 
 using CanvasPtr = PTR(Canvas);
+using GLStatePtr = PTR(GLState);
 using GUIPtr = PTR(GUI);
 using InputPtr = PTR(Input);
 using LogSystemPtr = PTR(LogSystem);
 using ShaderPtr = PTR(Shader);
+using StaticMeshPtr = PTR(StaticMesh);
+using LineSeriesPtr = PTR(LineSeries);
+using PathPtr = PTR(Path);
 using TexturePtr = PTR(Texture);
 using WindowPtr = PTR(Window);
 using EventPtr = PTR(IEvent);
 using EventHandlerPtr = PTR(EventHandler);
+using FontPtr = PTR(Font);
 
 #if defined(_WIN64) || defined(__x86_64__)
 using TextureID = uint64_t;
@@ -0,0 +1,159 @@
+#include "DamageTracker.h"
+
+#include <cmath>
+
+//rects are stored as (x0, y0, x1, y1) while merging
+static int64_t area(const ivec4& rect)
+{
+    return (int64_t)(rect.z - rect.x) * (rect.w - rect.y);
+}
+
+static ivec4 unite(const ivec4& a, const ivec4& b)
+{
+    return ivec4(min(a.x, b.x), min(a.y, b.y), max(a.z, b.z), max(a.w, b.w));
+}
+
+DamageTracker::DamageTracker() :
+    m_records(), m_previous(), m_history(), m_invalid(true)
+{
+}
+
+DamageTracker::~DamageTracker()
+{
+}
+
+void DamageTracker::begin()
+{
+    m_previous.swap(m_records);
+    m_records.clear();
+}
+
+void DamageTracker::track(uint64_t hash, const fvec4& bounds)
+{
+    m_records.push_back({ hash, bounds });
+}
+
+void DamageTracker::invalidate()
+{
+    m_invalid = true;
+}
+
+bool DamageTracker::compute(int32_t buffer_age, const ivec4& viewport, vector<ivec4>& rects)
+{
+    vector<ivec4> damage;
+
+    if (m_invalid)
+    {
+        damage.push_back(ivec4(viewport.x, viewport.y, viewport.x + viewport.z, viewport.y + viewport.w));
+        m_invalid = false;
+    }
+    else
+    {
+        size_t prefix = 0;
+        size_t count = min(m_records.size(), m_previous.size());
+        while (prefix < count && m_records[prefix].hash == m_previous[prefix].hash)
+            prefix++;
+
+        size_t suffix = 0;
+        while (suffix < count - prefix &&
+            m_records[m_records.size() - suffix - 1].hash == m_previous[m_previous.size() - suffix - 1].hash)
+            suffix++;
+
+        //whatever was drawn in between, this frame or the last one, needs repainting
+        for (size_t i = prefix; i + suffix < m_records.size(); i++)
+            add(damage, m_records[i].bounds, viewport);
+
+        for (size_t i = prefix; i + suffix < m_previous.size(); i++)
+            add(damage, m_previous[i].bounds, viewport);
+    }
+
+    m_history.insert(m_history.begin(), move(damage));
+    if (m_history.size() > MAX_BUFFER_AGE)
+        m_history.resize(MAX_BUFFER_AGE);
+
+    //an age of 0 means the back buffer contents are undefined
+    if (buffer_age <= 0 || buffer_age > (int32_t)m_history.size())
+        return false;
+
+    rects.clear();
+    for (int32_t i = 0; i < buffer_age; i++)
+    {
+        for (auto& rect : m_history[i])
+            add(rects, rect);
+    }
+
+    for (auto& rect : rects)
+    {
+        if (area(rect) >= (int64_t)viewport.z * viewport.w)
+            return false;
+
+        rect.z -= rect.x;
+        rect.w -= rect.y;
+    }
+
+    return true;
+}
+
+void DamageTracker::add(vector<ivec4>& rects, const fvec4& bounds, const ivec4& viewport)
+{
+    //round outwards, one extra pixel covers antialiased edges
+    ivec4 rect((int32_t)floor(bounds.x) - 1, (int32_t)floor(bounds.y) - 1, (int32_t)ceil(bounds.z) + 1, (int32_t)ceil(bounds.w) + 1);
+
+    rect.x = max(rect.x, viewport.x);
+    rect.y = max(rect.y, viewport.y);
+    rect.z = min(rect.z, viewport.x + viewport.z);
+    rect.w = min(rect.w, viewport.y + viewport.w);
+
+    add(rects, rect);
+}
+
+void DamageTracker::add(vector<ivec4>& rects, ivec4 rect)
+{
+    if (rect.x >= rect.z || rect.y >= rect.w)
+        return;
+
+    //swallow everything the new rect touches so the list never overlaps
+    size_t i = 0;
+    while (i < rects.size())
+    {
+        auto& other = rects[i];
+        if (rect.x <= other.z && rect.z >= other.x && rect.y <= other.w && rect.w >= other.y)
+        {
+            rect = unite(rect, other);
+            rects.erase(rects.begin() + i);
+            i = 0;
+            continue;
+        }
+
+        i++;
+    }
+
+    rects.push_back(rect);
+
+    //too many rects, join the pair that wastes the least area
+    while (rects.size() > MAX_RECTS)
+    {
+        size_t best_a = 0;
+        size_t best_b = 1;
+        int64_t best_cost = INT64_MAX;
+
+        for (size_t a = 0; a < rects.size(); a++)
+        {
+            for (size_t b = a + 1; b < rects.size(); b++)
+            {
+                auto cost = area(unite(rects[a], rects[b])) - area(rects[a]) - area(rects[b]);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+
+        auto merged = unite(rects[best_a], rects[best_b]);
+        rects.erase(rects.begin() + best_b);
+        rects.erase(rects.begin() + best_a);
+        add(rects, merged);
+    }
+}
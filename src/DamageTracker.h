@@ -0,0 +1,41 @@
+#ifndef _DAMAGE_TRACKER_H_
+#define _DAMAGE_TRACKER_H_
+
+#include "Config.h"
+
+//Compares the draws of consecutive frames by content hash and bounds. Draws
+//past the common prefix and suffix of both frames are damaged, the damage of
+//the last few frames is kept so a back buffer of any age up to MAX_BUFFER_AGE can be patched.
+class DamageTracker
+{
+public:
+    static const int32_t MAX_RECTS = 4;
+    static const int32_t MAX_BUFFER_AGE = 4;
+private:
+    struct Record
+    {
+        uint64_t hash;
+        fvec4 bounds;
+    };
+
+    vector<Record> m_records;
+    vector<Record> m_previous;
+    vector<vector<ivec4>> m_history;
+    bool m_invalid;
+public:
+    DamageTracker();
+    ~DamageTracker();
+
+    void begin();
+    void track(uint64_t hash, const fvec4& bounds);
+    void invalidate();
+
+    //false when the whole viewport has to be redrawn, otherwise rects holds the
+    //(x, y, w, h) regions to redraw, possibly none
+    bool compute(int32_t buffer_age, const ivec4& viewport, vector<ivec4>& rects);
+private:
+    void add(vector<ivec4>& rects, const fvec4& bounds, const ivec4& viewport);
+    void add(vector<ivec4>& rects, ivec4 rect);
+};
+
+#endif
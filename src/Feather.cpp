@@ -0,0 +1,74 @@
+#include "Feather.h"
+
+//longest miter relative to the half width before sharp corners get cut off
+static const float MAX_MITER = 4.0f;
+
+float ring_orientation(const fvec2* points, size_t count)
+{
+    double area = 0.0;
+    for (size_t i = 0, j = count - 1; i < count; j = i++)
+        area += ((double)points[j].x - points[i].x) * ((double)points[j].y + points[i].y);
+
+    return area > 0.0 ? 1.0f : -1.0f;
+}
+
+uint32_t feather_ring(const fvec2* points, size_t count, float width, float orientation, vector<VertexData>& vertices, vector<uint32_t>& indices)
+{
+    auto base = (uint32_t)vertices.size();
+    if (count < 2)
+        return base;
+
+    vertices.resize(base + count * 2);
+    indices.reserve(indices.size() + count * 6);
+
+    //outward normal of the edge leaving each point, repeated edges borrow their neighbour's
+    auto normal = [&](size_t i)
+    {
+        for (size_t step = 0; step < count; step++)
+        {
+            auto& a = points[(i + count - step) % count];
+            auto& b = points[(i + count - step + 1) % count];
+            auto d = b - a;
+            auto length = sqrtf(d.x * d.x + d.y * d.y);
+            if (length > 0.0f)
+                return fvec2(d.y, -d.x) * (orientation / length);
+        }
+
+        return fvec2();
+    };
+
+    auto half = width * 0.5f;
+    auto previous = normal(count - 1);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto next = normal(i);
+
+        //miter between both edges, stretched so the offset edges stay half the width away
+        auto miter = previous + next;
+        auto length = sqrtf(miter.x * miter.x + miter.y * miter.y);
+        fvec2 offset = next;
+        if (length > 1e-4f)
+        {
+            miter = miter / length;
+            auto cosine = miter.x * next.x + miter.y * next.y;
+            offset = miter * min(1.0f / max(cosine, 1e-4f), MAX_MITER);
+        }
+
+        vertices[base + i] = VertexData(points[i] - offset * half);
+        vertices[base + i].color = FEATHER_OPAQUE;
+        vertices[base + count + i] = VertexData(points[i] + offset * half);
+        vertices[base + count + i].color = FEATHER_CLEAR;
+
+        previous = next;
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)count; i++)
+    {
+        auto j = (i + 1) % (uint32_t)count;
+        uint32_t quad[6] = { base + i, base + j, base + (uint32_t)count + j, base + i, base + (uint32_t)count + j, base + (uint32_t)count + i };
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+
+    return base;
+}
@@ -0,0 +1,23 @@
+#ifndef _FEATHER_H_
+#define _FEATHER_H_
+
+#include "Config.h"
+#include "Canvas.h"
+
+//Analytic antialiasing for filled shapes: a fringe one pixel wide centred on the
+//edge whose coverage goes from 1 on the inside to 0 on the outside. Coverage is
+//carried in vertex alpha, so feathered geometry batches with everything else.
+//A fringe centred on a pixel aligned edge leaves it as sharp as without one
+
+static const uint32_t FEATHER_OPAQUE = 0xFFFFFFFF;
+static const uint32_t FEATHER_CLEAR = 0x00FFFFFF;
+
+//positive for rings going counter clockwise with y up, the solid side is on their left
+float ring_orientation(const fvec2* points, size_t count);
+
+//appends the ring moved half the width towards the solid side followed by a copy moved
+//half the width away from it at zero coverage, plus the strip joining them. Returns the
+//index of the first moved point, the caller fills the interior with those
+uint32_t feather_ring(const fvec2* points, size_t count, float width, float orientation, vector<VertexData>& vertices, vector<uint32_t>& indices);
+
+#endif
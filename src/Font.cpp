@@ -0,0 +1,167 @@
+#include "Font.h"
+#include "LogSystem.h"
+
+//private copy, imgui compiles its own static one as well
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <imstb_truetype.h>
+
+struct Font::Info
+{
+    stbtt_fontinfo font;
+};
+
+uint32_t Font::s_next_id = 1;
+
+Font::Font(GlyphMode mode) :
+    m_id(s_next_id++), m_data(), m_info(), m_mode(mode), m_glyphs()
+{
+}
+
+Font::~Font()
+{
+}
+
+bool Font::load(vector<uint8_t>&& data)
+{
+    m_data = move(data);
+    m_info = UNEW_0(Info);
+    m_glyphs.clear();
+
+    //too short for even the table directory stb_truetype reads without checking
+    auto offset = m_data.size() < 12 ? -1 : stbtt_GetFontOffsetForIndex(m_data.data(), 0);
+    if (offset < 0 || !stbtt_InitFont(&m_info->font, m_data.data(), offset))
+    {
+        LogSystem::get()->err("Failed to parse font");
+        m_info = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t Font::get_id()
+{
+    return m_id;
+}
+
+GlyphMode Font::get_mode()
+{
+    return m_mode;
+}
+
+int32_t Font::find_glyph(uint32_t codepoint)
+{
+    auto it = m_glyphs.find(codepoint);
+    if (it != m_glyphs.end())
+        return it->second;
+
+    //0 is the font's missing glyph box
+    auto glyph = stbtt_FindGlyphIndex(&m_info->font, (int)codepoint);
+    m_glyphs[codepoint] = glyph;
+
+    return glyph;
+}
+
+float Font::get_advance(int32_t glyph, float size)
+{
+    int advance = 0;
+    int bearing = 0;
+    stbtt_GetGlyphHMetrics(&m_info->font, glyph, &advance, &bearing);
+
+    return advance * stbtt_ScaleForPixelHeight(&m_info->font, size);
+}
+
+float Font::get_kerning(int32_t first, int32_t second, float size)
+{
+    return stbtt_GetGlyphKernAdvance(&m_info->font, first, second) * stbtt_ScaleForPixelHeight(&m_info->font, size);
+}
+
+void Font::get_metrics(float size, float& ascent, float& descent, float& line_gap)
+{
+    int a = 0;
+    int d = 0;
+    int g = 0;
+    stbtt_GetFontVMetrics(&m_info->font, &a, &d, &g);
+
+    auto scale = stbtt_ScaleForPixelHeight(&m_info->font, size);
+    ascent = a * scale;
+    descent = d * scale;
+    line_gap = g * scale;
+}
+
+bool Font::rasterize(int32_t glyph, float size, bool sdf, int32_t padding, vector<uint8_t>& pixels, ivec4& box)
+{
+    if (stbtt_IsGlyphEmpty(&m_info->font, glyph))
+        return false;
+
+    auto scale = stbtt_ScaleForPixelHeight(&m_info->font, size);
+    vector<uint8_t> alpha;
+
+    if (sdf)
+    {
+        //the edge sits at 128 and values fall off over the padding on either side
+        int width = 0;
+        int height = 0;
+        int x = 0;
+        int y = 0;
+
+        auto* field = stbtt_GetGlyphSDF(&m_info->font, scale, glyph, padding, 128, 128.0f / padding, &width, &height, &x, &y);
+        if (field == nullptr)
+            return false;
+
+        alpha.assign(field, field + width * height);
+        stbtt_FreeSDF(field, nullptr);
+        box = ivec4(x, y, width, height);
+    }
+    else
+    {
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = 0;
+        int y1 = 0;
+
+        stbtt_GetGlyphBitmapBox(&m_info->font, glyph, scale, scale, &x0, &y0, &x1, &y1);
+        if (x1 <= x0 || y1 <= y0)
+            return false;
+
+        alpha.resize((x1 - x0) * (y1 - y0));
+        stbtt_MakeGlyphBitmap(&m_info->font, alpha.data(), x1 - x0, y1 - y0, x1 - x0, scale, scale, glyph);
+        box = ivec4(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    pixels.resize(alpha.size() * 4);
+    for (size_t i = 0; i < alpha.size(); i++)
+    {
+        pixels[i * 4 + 0] = 0xFF;
+        pixels[i * 4 + 1] = 0xFF;
+        pixels[i * 4 + 2] = 0xFF;
+        pixels[i * 4 + 3] = alpha[i];
+    }
+
+    return true;
+}
+
+uint32_t Font::next_codepoint(const string& text, size_t& offset)
+{
+    static const uint32_t REPLACEMENT = 0xFFFD;
+
+    auto lead = (uint8_t)text[offset++];
+    if (lead < 0x80)
+        return lead;
+
+    int32_t length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+    if (length < 0 || lead >= 0xF8)
+        return REPLACEMENT;
+
+    uint32_t codepoint = lead & (0x3F >> length);
+    for (int32_t i = 0; i < length; i++)
+    {
+        if (offset >= text.size() || ((uint8_t)text[offset] & 0xC0) != 0x80)
+            return REPLACEMENT;
+
+        codepoint = (codepoint << 6) | ((uint8_t)text[offset++] & 0x3F);
+    }
+
+    return codepoint;
+}
@@ -0,0 +1,53 @@
+#ifndef _FONT_H_
+#define _FONT_H_
+
+#include "Config.h"
+
+enum class GlyphMode
+{
+    //coverage rasterized at the size the text ends up on screen, sharpest for fixed sizes
+    Bitmap,
+    //distance fields rasterized once at GlyphAtlas::SDF_SIZE, one glyph serves every size
+    SDF
+};
+
+//TrueType font parsed and rasterized with the stb_truetype copy that ships with imgui.
+//Sizes are pixel heights from the highest ascender to the lowest descender
+class Font
+{
+private:
+    struct Info;
+
+    static uint32_t s_next_id;
+
+    uint32_t m_id;
+    vector<uint8_t> m_data;
+    UPTR(Info) m_info;
+    GlyphMode m_mode;
+    unordered_map<uint32_t, int32_t> m_glyphs;
+
+    //only Canvas::create_font makes fonts, they're always loaded
+    friend class Canvas;
+
+    Font(GlyphMode mode);
+    bool load(vector<uint8_t>&& data);
+public:
+    ~Font();
+
+    uint32_t get_id();
+    GlyphMode get_mode();
+
+    int32_t find_glyph(uint32_t codepoint);
+    float get_advance(int32_t glyph, float size);
+    float get_kerning(int32_t first, int32_t second, float size);
+    void get_metrics(float size, float& ascent, float& descent, float& line_gap);
+
+    //white rgba with the coverage or distance in alpha, box is the offset from the pen
+    //on the baseline followed by the size. Returns false for glyphs without any pixels
+    bool rasterize(int32_t glyph, float size, bool sdf, int32_t padding, vector<uint8_t>& pixels, ivec4& box);
+
+    //advances offset past the utf-8 sequence it points at, malformed bytes decode as U+FFFD
+    static uint32_t next_codepoint(const string& text, size_t& offset);
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "GLState.h"
+
+GLStatePtr GLState::s_gl_state = nullptr;
+
+GLState::GLState() :
+    m_issued(0), m_avoided(0)
+{
+    invalidate();
+}
+
+GLState::~GLState()
+{
+}
+
+void GLState::use_program(uint32_t program)
+{
+    if (!changed(m_program, program))
+        return;
+
+    glUseProgram(program);
+    CHECK_GL_ERROR;
+}
+
+void GLState::bind_vertex_array(uint32_t vertex_array)
+{
+    if (!changed(m_vertex_array, vertex_array))
+        return;
+
+    glBindVertexArray(vertex_array);
+    CHECK_GL_ERROR;
+
+    //the element buffer binding belongs to the vertex array
+    m_element_buffer = UNKNOWN;
+}
+
+void GLState::bind_buffer(uint32_t target, uint32_t buffer)
+{
+    uint32_t* shadow = nullptr;
+    switch (target)
+    {
+        case GL_ARRAY_BUFFER:
+            shadow = &m_array_buffer;
+            break;
+
+        case GL_ELEMENT_ARRAY_BUFFER:
+            shadow = &m_element_buffer;
+            break;
+
+        case GL_UNIFORM_BUFFER:
+            shadow = &m_uniform_buffer;
+            break;
+    }
+
+    if (shadow != nullptr && !changed(*shadow, buffer))
+        return;
+
+    if (shadow == nullptr)
+        m_issued++;
+
+    glBindBuffer(target, buffer);
+    CHECK_GL_ERROR;
+}
+
+void GLState::bind_buffer_base(uint32_t target, uint32_t index, uint32_t buffer)
+{
+    if (target == GL_UNIFORM_BUFFER && index < MAX_UNIFORM_BINDINGS)
+    {
+        if (!changed(m_uniform_bindings[index], buffer))
+            return;
+    }
+    else
+    {
+        m_issued++;
+    }
+
+    glBindBufferBase(target, index, buffer);
+    CHECK_GL_ERROR;
+
+    //binding an indexed target also replaces the generic one
+    if (target == GL_UNIFORM_BUFFER)
+        m_uniform_buffer = buffer;
+}
+
+void GLState::bind_texture(uint32_t unit, uint32_t texture)
+{
+    if (unit >= MAX_TEXTURE_UNITS)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        CHECK_GL_ERROR;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        CHECK_GL_ERROR;
+
+        m_active_unit = unit;
+        m_issued += 2;
+        return;
+    }
+
+    if (!changed(m_textures[unit], texture))
+        return;
+
+    if (changed(m_active_unit, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        CHECK_GL_ERROR;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    CHECK_GL_ERROR;
+}
+
+void GLState::set_scissor(bool enabled, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    if (changed(m_scissor, enabled))
+    {
+        if (enabled)
+            glEnable(GL_SCISSOR_TEST);
+        else
+            glDisable(GL_SCISSOR_TEST);
+        CHECK_GL_ERROR;
+    }
+
+    if (!enabled)
+        return;
+
+    ivec4 rect(x, y, w, h);
+    if (rect == m_scissor_rect)
+    {
+        m_avoided++;
+        return;
+    }
+
+    m_scissor_rect = rect;
+    m_issued++;
+
+    glScissor(x, y, w, h);
+    CHECK_GL_ERROR;
+}
+
+void GLState::set_blend(bool enabled, uint32_t src, uint32_t dst)
+{
+    if (changed(m_blend, enabled))
+    {
+        if (enabled)
+            glEnable(GL_BLEND);
+        else
+            glDisable(GL_BLEND);
+        CHECK_GL_ERROR;
+    }
+
+    if (!enabled)
+        return;
+
+    if (src == m_blend_src && dst == m_blend_dst)
+    {
+        m_avoided++;
+        return;
+    }
+
+    m_blend_src = src;
+    m_blend_dst = dst;
+    m_issued++;
+
+    glBlendFunc(src, dst);
+    CHECK_GL_ERROR;
+}
+
+void GLState::set_depth_test(bool enabled)
+{
+    if (!changed(m_depth_test, enabled))
+        return;
+
+    if (enabled)
+        glEnable(GL_DEPTH_TEST);
+    else
+        glDisable(GL_DEPTH_TEST);
+    CHECK_GL_ERROR;
+}
+
+void GLState::set_stencil_test(bool enabled)
+{
+    if (!changed(m_stencil_test, enabled))
+        return;
+
+    if (enabled)
+        glEnable(GL_STENCIL_TEST);
+    else
+        glDisable(GL_STENCIL_TEST);
+    CHECK_GL_ERROR;
+}
+
+void GLState::set_color_mask(bool enabled)
+{
+    if (!changed(m_color_mask, enabled))
+        return;
+
+    glColorMask(enabled, enabled, enabled, enabled);
+    CHECK_GL_ERROR;
+}
+
+void GLState::delete_program(uint32_t program)
+{
+    glDeleteProgram(program);
+    CHECK_GL_ERROR;
+
+    if (m_program == program)
+        m_program = UNKNOWN;
+}
+
+void GLState::delete_vertex_array(uint32_t vertex_array)
+{
+    glDeleteVertexArrays(1, &vertex_array);
+    CHECK_GL_ERROR;
+
+    //deleting the bound vertex array reverts to 0
+    if (m_vertex_array == vertex_array)
+    {
+        m_vertex_array = 0;
+        m_element_buffer = UNKNOWN;
+    }
+}
+
+void GLState::delete_buffer(uint32_t buffer)
+{
+    glDeleteBuffers(1, &buffer);
+    CHECK_GL_ERROR;
+
+    if (m_array_buffer == buffer)
+        m_array_buffer = 0;
+
+    if (m_element_buffer == buffer)
+        m_element_buffer = UNKNOWN;
+
+    if (m_uniform_buffer == buffer)
+        m_uniform_buffer = 0;
+
+    for (auto& bound : m_uniform_bindings)
+    {
+        if (bound == buffer)
+            bound = 0;
+    }
+}
+
+void GLState::delete_texture(uint32_t texture)
+{
+    glDeleteTextures(1, &texture);
+    CHECK_GL_ERROR;
+
+    for (auto& bound : m_textures)
+    {
+        if (bound == texture)
+            bound = 0;
+    }
+}
+
+void GLState::invalidate()
+{
+    m_program = UNKNOWN;
+    m_vertex_array = UNKNOWN;
+    m_array_buffer = UNKNOWN;
+    m_element_buffer = UNKNOWN;
+    m_uniform_buffer = UNKNOWN;
+    m_active_unit = UNKNOWN;
+    m_textures.fill(UNKNOWN);
+    m_uniform_bindings.fill(UNKNOWN);
+
+    m_scissor = -1;
+    m_scissor_rect = ivec4(-1);
+    m_blend = -1;
+    m_depth_test = -1;
+    m_stencil_test = -1;
+    m_color_mask = -1;
+    m_blend_src = UNKNOWN;
+    m_blend_dst = UNKNOWN;
+}
+
+uint64_t GLState::get_issued_calls()
+{
+    return m_issued;
+}
+
+uint64_t GLState::get_avoided_calls()
+{
+    return m_avoided;
+}
+
+bool GLState::changed(uint32_t& shadow, uint32_t value)
+{
+    if (shadow == value)
+    {
+        m_avoided++;
+        return false;
+    }
+
+    shadow = value;
+    m_issued++;
+    return true;
+}
+
+bool GLState::changed(int32_t& shadow, bool value)
+{
+    if (shadow == (value ? 1 : 0))
+    {
+        m_avoided++;
+        return false;
+    }
+
+    shadow = value ? 1 : 0;
+    m_issued++;
+    return true;
+}
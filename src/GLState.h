@@ -0,0 +1,77 @@
+#ifndef _GL_STATE_H_
+#define _GL_STATE_H_
+
+#include "Config.h"
+
+//Shadows the GL state the engine touches and drops calls that wouldn't change
+//anything. Code issuing GL calls behind its back has to call invalidate() afterwards
+class GLState
+{
+public:
+    static const int32_t MAX_TEXTURE_UNITS = 16;
+    static const int32_t MAX_UNIFORM_BINDINGS = 8;
+private:
+    static GLStatePtr s_gl_state;
+
+    static const uint32_t UNKNOWN = 0xFFFFFFFF;
+
+    uint32_t m_program;
+    uint32_t m_vertex_array;
+    uint32_t m_array_buffer;
+    uint32_t m_element_buffer;
+    uint32_t m_uniform_buffer;
+    uint32_t m_active_unit;
+    array<uint32_t, MAX_TEXTURE_UNITS> m_textures;
+    array<uint32_t, MAX_UNIFORM_BINDINGS> m_uniform_bindings;
+
+    int32_t m_scissor;
+    ivec4 m_scissor_rect;
+    int32_t m_blend;
+    int32_t m_depth_test;
+    int32_t m_stencil_test;
+    int32_t m_color_mask;
+    uint32_t m_blend_src;
+    uint32_t m_blend_dst;
+
+    uint64_t m_issued;
+    uint64_t m_avoided;
+public:
+    GLState();
+    ~GLState();
+
+    void use_program(uint32_t program);
+    void bind_vertex_array(uint32_t vertex_array);
+    void bind_buffer(uint32_t target, uint32_t buffer);
+    void bind_buffer_base(uint32_t target, uint32_t index, uint32_t buffer);
+    void bind_texture(uint32_t unit, uint32_t texture);
+    void set_scissor(bool enabled, int32_t x = 0, int32_t y = 0, int32_t w = 0, int32_t h = 0);
+    void set_blend(bool enabled, uint32_t src = GL_SRC_ALPHA, uint32_t dst = GL_ONE_MINUS_SRC_ALPHA);
+    void set_depth_test(bool enabled);
+    void set_stencil_test(bool enabled);
+    void set_color_mask(bool enabled);
+
+    void delete_program(uint32_t program);
+    void delete_vertex_array(uint32_t vertex_array);
+    void delete_buffer(uint32_t buffer);
+    void delete_texture(uint32_t texture);
+
+    void invalidate();
+
+    uint64_t get_issued_calls();
+    uint64_t get_avoided_calls();
+
+    static GLStatePtr get()
+    {
+        if (s_gl_state == nullptr)
+        {
+            s_gl_state = NEW_0(GLState);
+        }
+
+        return s_gl_state;
+    }
+private:
+    bool changed(uint32_t& shadow, uint32_t value);
+    bool changed(int32_t& shadow, bool value);
+};
+
+#endif
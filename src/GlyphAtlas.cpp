@@ -0,0 +1,189 @@
+#include "GlyphAtlas.h"
+#include "LogSystem.h"
+#include "SkylinePacker.h"
+#include "GLState.h"
+#include "Texture.h"
+#include "Font.h"
+#include "Hash.h"
+
+GlyphAtlas::GlyphAtlas() :
+    m_pages(), m_glyphs(), m_dropped(), m_pixels(), m_frame(1), m_full_frame(0), m_stats()
+{
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+    clear();
+}
+
+void GlyphAtlas::next_frame()
+{
+    m_frame++;
+}
+
+const Glyph& GlyphAtlas::get(FontPtr font, int32_t glyph, int32_t size)
+{
+    auto sdf = font->get_mode() == GlyphMode::SDF;
+    if (sdf)
+        size = SDF_SIZE;
+
+    auto key = hash_value(size, hash_value(glyph, hash_value(font->get_id())));
+    auto it = m_glyphs.find(key);
+    if (it != m_glyphs.end())
+    {
+        if (it->second.page != -1)
+            m_pages[it->second.page].last_used = m_frame;
+
+        m_stats.hits++;
+        return it->second;
+    }
+
+    m_stats.misses++;
+
+    Glyph entry = {};
+    entry.page = -1;
+    entry.advance = font->get_advance(glyph, (float)size);
+
+    ivec4 box;
+    if (font->rasterize(glyph, (float)size, sdf, SDF_PADDING, m_pixels, box))
+    {
+        ivec2 position;
+        entry.page = place(box.z, box.w, position);
+
+        //not cached, the glyph is tried again once a page frees up
+        if (entry.page == -1 && m_full_frame == m_frame)
+        {
+            m_dropped = entry;
+            return m_dropped;
+        }
+
+        if (entry.page != -1)
+        {
+            auto& page = m_pages[entry.page];
+            GLState::get()->bind_texture(0, (uint32_t)page.texture->get_id());
+            glTexSubImage2D(GL_TEXTURE_2D, 0, position.x, position.y, box.z, box.w, GL_RGBA, GL_UNSIGNED_BYTE, m_pixels.data());
+            CHECK_GL_ERROR;
+
+            entry.quad = fvec4((float)box.x, (float)box.y, (float)(box.x + box.z), (float)(box.y + box.w));
+            auto texel = 1.0f / PAGE_SIZE;
+            entry.uv = fvec4(position.x * texel, position.y * texel, (position.x + box.z) * texel, (position.y + box.w) * texel);
+
+            page.glyphs.push_back(key);
+            page.last_used = m_frame;
+        }
+    }
+
+    return m_glyphs[key] = entry;
+}
+
+TexturePtr GlyphAtlas::get_texture(int32_t page)
+{
+    return m_pages[page].texture;
+}
+
+int32_t GlyphAtlas::get_page_count()
+{
+    return (int32_t)m_pages.size();
+}
+
+void GlyphAtlas::clear()
+{
+    for (auto& page : m_pages)
+        GLState::get()->delete_texture((uint32_t)page.texture->get_id());
+
+    m_pages.clear();
+    m_glyphs.clear();
+}
+
+GlyphAtlasStats GlyphAtlas::get_stats()
+{
+    auto stats = m_stats;
+    stats.pages = (int32_t)m_pages.size();
+    stats.glyphs = (int32_t)m_glyphs.size();
+
+    return stats;
+}
+
+int32_t GlyphAtlas::place(int32_t width, int32_t height, ivec2& position)
+{
+    if (width + PADDING > PAGE_SIZE || height + PADDING > PAGE_SIZE)
+    {
+        LogSystem::get()->warn("Glyph of %ix%i doesn't fit a glyph page", width, height);
+        return -1;
+    }
+
+    for (size_t i = 0; i < m_pages.size(); i++)
+    {
+        if (m_pages[i].packer->pack(width + PADDING, height + PADDING, position))
+            return (int32_t)i;
+    }
+
+    //reuse the least recently used page unless every page is still needed this frame
+    int32_t target = -1;
+    if (m_pages.size() >= MAX_PAGES)
+    {
+        for (size_t i = 0; i < m_pages.size(); i++)
+        {
+            if (m_pages[i].last_used < m_frame && (target == -1 || m_pages[i].last_used < m_pages[target].last_used))
+                target = (int32_t)i;
+        }
+    }
+
+    if (target == -1 && m_pages.size() >= MAX_PAGES)
+    {
+        if (m_full_frame != m_frame)
+            LogSystem::get()->warn("Every glyph page is in use this frame, glyphs are dropped until the next one");
+
+        m_full_frame = m_frame;
+        m_stats.dropped++;
+        return -1;
+    }
+
+    if (target == -1)
+    {
+        m_pages.emplace_back();
+        create_page(m_pages.back());
+        target = (int32_t)m_pages.size() - 1;
+    }
+    else
+    {
+        evict(m_pages[target]);
+    }
+
+    m_pages[target].packer->pack(width + PADDING, height + PADDING, position);
+    return target;
+}
+
+void GlyphAtlas::create_page(Page& page)
+{
+    uint32_t texture;
+    glGenTextures(1, &texture);
+    CHECK_GL_ERROR;
+    GLState::get()->bind_texture(0, texture);
+
+    //linear so glyphs drawn between pixels or scaled, like every distance field, stay smooth
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    CHECK_GL_ERROR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    CHECK_GL_ERROR;
+
+    //cleared so the padding between glyphs samples as transparent
+    vector<uint8_t> pixels(PAGE_SIZE * PAGE_SIZE * 4, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PAGE_SIZE, PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    CHECK_GL_ERROR;
+
+    page.texture = NEW_3(Texture, texture, (float)PAGE_SIZE, (float)PAGE_SIZE);
+    page.packer = UNEW_2(SkylinePacker, PAGE_SIZE, PAGE_SIZE);
+    page.last_used = m_frame;
+}
+
+void GlyphAtlas::evict(Page& page)
+{
+    for (auto key : page.glyphs)
+        m_glyphs.erase(key);
+
+    page.glyphs.clear();
+    page.packer->reset();
+    page.last_used = m_frame;
+    m_stats.evictions++;
+}
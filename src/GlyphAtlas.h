@@ -0,0 +1,78 @@
+#ifndef _GLYPH_ATLAS_H_
+#define _GLYPH_ATLAS_H_
+
+#include "Config.h"
+
+class SkylinePacker;
+
+struct GlyphAtlasStats
+{
+    int32_t pages;
+    int32_t glyphs;
+    int64_t hits;
+    int64_t misses;
+    int32_t evictions;
+    int32_t dropped;
+};
+
+struct Glyph
+{
+    //-1 for glyphs without pixels, like spaces
+    int32_t page;
+    //corners relative to the pen on the baseline and uvs in the page
+    fvec4 quad;
+    fvec4 uv;
+    float advance;
+};
+
+//Glyphs of every font and size share these pages, rasterized the first time
+//they're drawn. When no page has room the least recently used one is cleared
+//as a whole, pages drawn from this frame are left alone since their batches
+//haven't been rendered yet. With all MAX_PAGES in use this frame new glyphs are
+//skipped until the next frame.
+class GlyphAtlas
+{
+public:
+    static const int32_t SDF_SIZE = 48;
+    static const int32_t SDF_PADDING = 6;
+    //larger bitmap text is scaled up from glyphs of this size
+    static const int32_t MAX_BITMAP_SIZE = 256;
+private:
+    static const int32_t PAGE_SIZE = 1024;
+    static const int32_t MAX_PAGES = 4;
+    static const int32_t PADDING = 1;
+
+    struct Page
+    {
+        TexturePtr texture;
+        UPTR(SkylinePacker) packer;
+        uint64_t last_used;
+        vector<uint64_t> glyphs;
+    };
+
+    vector<Page> m_pages;
+    unordered_map<uint64_t, Glyph> m_glyphs;
+    Glyph m_dropped;
+    vector<uint8_t> m_pixels;
+    uint64_t m_frame;
+    uint64_t m_full_frame;
+    GlyphAtlasStats m_stats;
+public:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    void next_frame();
+    //bitmap glyphs are keyed by their pixel size, distance fields always come at SDF_SIZE
+    const Glyph& get(FontPtr font, int32_t glyph, int32_t size);
+    TexturePtr get_texture(int32_t page);
+    int32_t get_page_count();
+    void clear();
+
+    GlyphAtlasStats get_stats();
+private:
+    int32_t place(int32_t width, int32_t height, ivec2& position);
+    void create_page(Page& page);
+    void evict(Page& page);
+};
+
+#endif
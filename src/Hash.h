@@ -0,0 +1,39 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include "Config.h"
+
+#define HASH_OFFSET_BASIS 14695981039346656037ULL
+#define HASH_PRIME 1099511628211ULL
+
+//64-bit FNV-1a, pass the previous result as hash to chain several blocks
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    auto* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+
+    return hash;
+}
+
+//compile time variant for names, matches hash_bytes over the same characters
+constexpr uint64_t hash_string(const char* str, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    return *str == 0 ? hash : hash_string(str + 1, (hash ^ (uint8_t)*str) * HASH_PRIME);
+}
+
+inline uint64_t hash_string(const string& str)
+{
+    return hash_bytes(str.data(), str.size());
+}
+
+template<typename T>
+inline uint64_t hash_value(const T& value, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    return hash_bytes(&value, sizeof(T), hash);
+}
+
+#endif
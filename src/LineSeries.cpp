@@ -0,0 +1,259 @@
+#include "LineSeries.h"
+#include "Hash.h"
+
+#include <cfloat>
+
+static const size_t SIMPLIFY_BLOCK = 4096;
+
+static inline fvec2 transform_point(const fmatrix4& matrix, const fvec2& point)
+{
+    return fvec2(matrix[0][0] * point.x + matrix[1][0] * point.y + matrix[3][0],
+        matrix[0][1] * point.x + matrix[1][1] * point.y + matrix[3][1]);
+}
+
+static float segment_distance(const fvec2& p, const fvec2& a, const fvec2& b)
+{
+    fvec2 ab = b - a;
+    fvec2 ap = p - a;
+
+    float length = ab.x * ab.x + ab.y * ab.y;
+    float t = length > 0.0f ? max(0.0f, min(1.0f, (ap.x * ab.x + ap.y * ab.y) / length)) : 0.0f;
+
+    fvec2 d = ap - ab * t;
+    return d.x * d.x + d.y * d.y;
+}
+
+//emits the kept points of [a, b), b itself belongs to whatever follows
+static void simplify(const fvec2* points, size_t a, size_t b, const fmatrix4& matrix, float tolerance, vector<fvec2>& output)
+{
+    auto start = transform_point(matrix, points[a]);
+    auto end = transform_point(matrix, points[b]);
+
+    size_t farthest = a;
+    float distance = tolerance * tolerance;
+    for (size_t i = a + 1; i < b; i++)
+    {
+        auto d = segment_distance(transform_point(matrix, points[i]), start, end);
+        if (d > distance)
+        {
+            distance = d;
+            farthest = i;
+        }
+    }
+
+    if (farthest == a)
+    {
+        output.push_back(points[a]);
+        return;
+    }
+
+    simplify(points, a, farthest, matrix, tolerance, output);
+    simplify(points, farthest, b, matrix, tolerance, output);
+}
+
+size_t decimate_columns(const fvec2* points, size_t first, size_t count, const fmatrix4& matrix, vector<fvec2>& output, size_t& resume_output)
+{
+    size_t resume = first;
+    resume_output = output.size();
+
+    size_t i = first;
+    while (i < count)
+    {
+        auto start = i;
+        auto point = transform_point(matrix, points[i]);
+        auto column = floorf(point.x);
+
+        size_t lowest = i;
+        size_t highest = i;
+        float low = point.y;
+        float high = point.y;
+
+        for (i++; i < count; i++)
+        {
+            point = transform_point(matrix, points[i]);
+            if (floorf(point.x) != column)
+                break;
+
+            if (point.y < low)
+            {
+                low = point.y;
+                lowest = i;
+            }
+
+            if (point.y > high)
+            {
+                high = point.y;
+                highest = i;
+            }
+        }
+
+        resume = start;
+        resume_output = output.size();
+
+        //in source order so the line still walks through the column the way it did
+        size_t keep[4] = { start, min(lowest, highest), max(lowest, highest), i - 1 };
+        for (int32_t k = 0; k < 4; k++)
+        {
+            if (k == 0 || keep[k] != keep[k - 1])
+                output.push_back(points[keep[k]]);
+        }
+    }
+
+    return resume;
+}
+
+size_t simplify_path(const fvec2* points, size_t first, size_t count, const fmatrix4& matrix, float tolerance, vector<fvec2>& output, size_t& resume_output)
+{
+    resume_output = output.size();
+    if (first + 1 >= count)
+    {
+        if (first < count)
+            output.push_back(points[first]);
+
+        return first;
+    }
+
+    //blocks bound the recursion and keep appends from redoing the whole path
+    size_t start = first;
+    while (true)
+    {
+        auto end = min(count - 1, start + SIMPLIFY_BLOCK);
+        resume_output = output.size();
+
+        simplify(points, start, end, matrix, tolerance, output);
+        if (end == count - 1)
+        {
+            output.push_back(points[end]);
+            return start;
+        }
+
+        start = end;
+    }
+}
+
+bool monotonic(const fvec2* points, size_t count)
+{
+    int32_t direction = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        if (points[i].x == points[i - 1].x)
+            continue;
+
+        int32_t step = points[i].x > points[i - 1].x ? 1 : -1;
+        if (direction != 0 && step != direction)
+            return false;
+
+        direction = step;
+    }
+
+    return true;
+}
+
+void decimate_polyline(const fvec2* points, size_t count, const fmatrix4& matrix, float tolerance, vector<fvec2>& output)
+{
+    output.clear();
+
+    //columns only follow source x as long as the matrix doesn't mix y into it
+    size_t resume_output = 0;
+    if (matrix[1][0] == 0.0f && monotonic(points, count))
+        decimate_columns(points, 0, count, matrix, output, resume_output);
+    else
+        simplify_path(points, 0, count, matrix, tolerance, output, resume_output);
+}
+
+LineSeries::LineSeries() :
+    m_points(), m_direction(0), m_lod(), m_lod_key(0), m_lod_points(0), m_resume(0), m_resume_output(0)
+{
+}
+
+LineSeries::~LineSeries()
+{
+}
+
+void LineSeries::append(const fvec2& point)
+{
+    track(point);
+    m_points.push_back(point);
+}
+
+void LineSeries::append(const vector<fvec2>& points)
+{
+    m_points.reserve(m_points.size() + points.size());
+
+    for (auto& point : points)
+    {
+        track(point);
+        m_points.push_back(point);
+    }
+}
+
+void LineSeries::clear()
+{
+    m_points.clear();
+    m_direction = 0;
+    m_lod.clear();
+    m_lod_key = 0;
+    m_lod_points = 0;
+}
+
+size_t LineSeries::size()
+{
+    return m_points.size();
+}
+
+bool LineSeries::monotonic()
+{
+    return m_direction != 2;
+}
+
+const vector<fvec2>& LineSeries::get_points()
+{
+    return m_points;
+}
+
+const vector<fvec2>& LineSeries::decimate(const fmatrix4& matrix, float tolerance)
+{
+    bool columns = matrix[1][0] == 0.0f && monotonic();
+
+    //once the series covers fewer pixels than it has points decimation starts paying off
+    auto first = transform_point(matrix, m_points.empty() ? fvec2() : m_points.front());
+    auto last = transform_point(matrix, m_points.empty() ? fvec2() : m_points.back());
+    if (columns && m_points.size() <= (size_t)fabsf(last.x - first.x) + 2)
+        return m_points;
+
+    auto key = hash_value(matrix, hash_value(tolerance, hash_value(columns)));
+    if (key != m_lod_key || m_lod_points > m_points.size())
+    {
+        m_lod.clear();
+        m_lod_key = key;
+        m_resume = 0;
+        m_resume_output = 0;
+    }
+    else if (m_lod_points == m_points.size())
+    {
+        return m_lod;
+    }
+
+    //only the last column or block can change when points get appended
+    m_lod.resize(m_resume_output);
+    if (columns)
+        m_resume = decimate_columns(m_points.data(), m_resume, m_points.size(), matrix, m_lod, m_resume_output);
+    else
+        m_resume = simplify_path(m_points.data(), m_resume, m_points.size(), matrix, tolerance, m_lod, m_resume_output);
+
+    m_lod_points = m_points.size();
+    return m_lod;
+}
+
+void LineSeries::track(const fvec2& point)
+{
+    //0 undecided, 1 or -1 the direction x moves in, 2 not monotonic
+    if (m_points.empty() || m_direction == 2 || point.x == m_points.back().x)
+        return;
+
+    int32_t step = point.x > m_points.back().x ? 1 : -1;
+    if (m_direction == 0)
+        m_direction = step;
+    else if (m_direction != step)
+        m_direction = 2;
+}
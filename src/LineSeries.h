@@ -0,0 +1,46 @@
+#ifndef _LINE_SERIES_H_
+#define _LINE_SERIES_H_
+
+#include "Config.h"
+
+//Reduces a polyline to what can show up at the resolution it's drawn at. Series
+//with increasing or decreasing x keep the first, lowest, highest and last point of
+//every pixel column, anything else is simplified with Douglas-Peucker at tolerance
+//pixels. Both run in blocks, resume returns the first source point of the last block
+//and resume_output where its output starts, so appended points only redo that block.
+size_t decimate_columns(const fvec2* points, size_t first, size_t count, const fmatrix4& matrix, vector<fvec2>& output, size_t& resume_output);
+size_t simplify_path(const fvec2* points, size_t first, size_t count, const fmatrix4& matrix, float tolerance, vector<fvec2>& output, size_t& resume_output);
+bool monotonic(const fvec2* points, size_t count);
+void decimate_polyline(const fvec2* points, size_t count, const fmatrix4& matrix, float tolerance, vector<fvec2>& output);
+
+//Point buffer for series that keep growing, the decimated copy is kept for the
+//matrix it was last drawn with and only extended when points are appended
+class LineSeries
+{
+private:
+    vector<fvec2> m_points;
+    int32_t m_direction;
+
+    vector<fvec2> m_lod;
+    uint64_t m_lod_key;
+    size_t m_lod_points;
+    size_t m_resume;
+    size_t m_resume_output;
+public:
+    LineSeries();
+    ~LineSeries();
+
+    void append(const fvec2& point);
+    void append(const vector<fvec2>& points);
+    void clear();
+
+    size_t size();
+    bool monotonic();
+    const vector<fvec2>& get_points();
+    //falls back to the points themselves while there are fewer of them than pixels covered
+    const vector<fvec2>& decimate(const fmatrix4& matrix, float tolerance = 0.5f);
+private:
+    void track(const fvec2& point);
+};
+
+#endif
@@ -0,0 +1,322 @@
+#include "Path.h"
+#include "Triangulate.h"
+
+#include <algorithm>
+#include <cfloat>
+
+static const float PI = 3.14159265358979f;
+static const int32_t MAX_SEGMENTS = 1024;
+//bigger rings go straight to the stencil fill. Past this the simple test takes 15-20 ms on
+//spiky rings and mostly gives up, at 100k points it's 90-280 ms. See bench/TriangulateBench
+static const size_t MAX_TRIANGULATE_POINTS = 4096;
+
+Path::Path() :
+    m_commands(), m_points(), m_version(0), m_cache()
+{
+}
+
+Path::~Path()
+{
+}
+
+void Path::move_to(float x, float y)
+{
+    m_commands.push_back(Command::Move);
+    m_points.emplace_back(x, y);
+    m_version++;
+}
+
+void Path::line_to(float x, float y)
+{
+    m_commands.push_back(Command::Line);
+    m_points.emplace_back(x, y);
+    m_version++;
+}
+
+void Path::quad_to(float cx, float cy, float x, float y)
+{
+    m_commands.push_back(Command::Quad);
+    m_points.emplace_back(cx, cy);
+    m_points.emplace_back(x, y);
+    m_version++;
+}
+
+void Path::cubic_to(float c1x, float c1y, float c2x, float c2y, float x, float y)
+{
+    m_commands.push_back(Command::Cubic);
+    m_points.emplace_back(c1x, c1y);
+    m_points.emplace_back(c2x, c2y);
+    m_points.emplace_back(x, y);
+    m_version++;
+}
+
+void Path::arc(float cx, float cy, float radius, float start, float end)
+{
+    m_commands.push_back(Command::Arc);
+    m_points.emplace_back(cx, cy);
+    m_points.emplace_back(radius, 0.0f);
+    m_points.emplace_back(start, end);
+    m_version++;
+}
+
+void Path::close()
+{
+    m_commands.push_back(Command::Close);
+    m_version++;
+}
+
+void Path::clear()
+{
+    m_commands.clear();
+    m_points.clear();
+    m_cache.clear();
+    m_version++;
+}
+
+bool Path::empty()
+{
+    return m_commands.empty();
+}
+
+uint32_t Path::get_version()
+{
+    return m_version;
+}
+
+const vector<PathContour>& Path::flatten(float scale, float tolerance)
+{
+    return lookup(scale, tolerance).contours;
+}
+
+const PathFill& Path::fill(float scale, float tolerance)
+{
+    auto& entry = lookup(scale, tolerance);
+    if (!entry.filled)
+    {
+        build(entry.contours, entry.fill);
+        entry.filled = true;
+    }
+
+    return entry.fill;
+}
+
+Path::Flattened& Path::lookup(float scale, float tolerance)
+{
+    //quarter octaves, flattened for the largest scale in the bucket so the tolerance holds for all of it
+    auto bucket = (int32_t)floorf(log2f(max(scale, 1e-6f)) * 4.0f);
+
+    for (size_t i = 0; i < m_cache.size(); i++)
+    {
+        auto& entry = m_cache[i];
+        if (entry.bucket != bucket || entry.tolerance != tolerance || entry.version != m_version)
+            continue;
+
+        //most recently used first
+        rotate(m_cache.begin(), m_cache.begin() + i, m_cache.begin() + i + 1);
+        return m_cache.front();
+    }
+
+    //stale entries go first, then the least recently used one
+    m_cache.erase(remove_if(m_cache.begin(), m_cache.end(), [this](const Flattened& entry) { return entry.version != m_version; }), m_cache.end());
+    if (m_cache.size() >= MAX_CACHED)
+        m_cache.pop_back();
+
+    Flattened entry;
+    entry.bucket = bucket;
+    entry.tolerance = tolerance;
+    entry.version = m_version;
+    entry.filled = false;
+    build(exp2f((bucket + 1) / 4.0f), tolerance, entry.contours);
+
+    m_cache.insert(m_cache.begin(), move(entry));
+    return m_cache.front();
+}
+
+void Path::build(float scale, float tolerance, vector<PathContour>& contours)
+{
+    //segment counts from Wang's formula, n = sqrt(d * (d - 1) / 8 * M / tolerance) with M the
+    //largest second difference of the control points in device pixels
+    auto segments = [&](float factor, float second_difference)
+    {
+        auto n = ceilf(sqrtf(factor * second_difference * scale / tolerance));
+        return max(1, min(MAX_SEGMENTS, (int32_t)n));
+    };
+
+    fvec2 current;
+    fvec2 start;
+    size_t p = 0;
+
+    auto contour = [&]() -> PathContour&
+    {
+        if (contours.empty() || contours.back().closed)
+        {
+            contours.push_back({ { current }, false });
+            start = current;
+        }
+
+        return contours.back();
+    };
+
+    for (auto command : m_commands)
+    {
+        switch (command)
+        {
+            case Command::Move:
+            {
+                current = m_points[p++];
+                start = current;
+                contours.push_back({ { current }, false });
+                break;
+            }
+
+            case Command::Line:
+            {
+                current = m_points[p++];
+                contour().points.push_back(current);
+                break;
+            }
+
+            case Command::Quad:
+            {
+                auto& points = contour().points;
+                auto c = m_points[p++];
+                auto end = m_points[p++];
+
+                auto n = segments(0.25f, glm::length(current - c * 2.0f + end));
+                for (int32_t i = 1; i <= n; i++)
+                {
+                    float t = (float)i / n;
+                    float u = 1.0f - t;
+                    points.push_back(current * (u * u) + c * (2.0f * u * t) + end * (t * t));
+                }
+
+                current = end;
+                break;
+            }
+
+            case Command::Cubic:
+            {
+                auto& points = contour().points;
+                auto c1 = m_points[p++];
+                auto c2 = m_points[p++];
+                auto end = m_points[p++];
+
+                auto n = segments(0.75f, max(glm::length(current - c1 * 2.0f + c2), glm::length(c1 - c2 * 2.0f + end)));
+                for (int32_t i = 1; i <= n; i++)
+                {
+                    float t = (float)i / n;
+                    float u = 1.0f - t;
+                    points.push_back(current * (u * u * u) + c1 * (3.0f * u * u * t) + c2 * (3.0f * u * t * t) + end * (t * t * t));
+                }
+
+                current = end;
+                break;
+            }
+
+            case Command::Arc:
+            {
+                auto center = m_points[p++];
+                auto radius = m_points[p++].x;
+                auto angles = m_points[p++];
+                auto sweep = angles.y - angles.x;
+
+                fvec2 first(center.x + cosf(angles.x) * radius, center.y + sinf(angles.x) * radius);
+                bool fresh = contours.empty() || contours.back().closed;
+                if (fresh)
+                {
+                    current = first;
+                    contours.push_back({ { first }, false });
+                    start = first;
+                }
+                else
+                {
+                    contours.back().points.push_back(first);
+                }
+
+                //largest step that keeps the chord within tolerance of the circle
+                auto device_radius = radius * scale;
+                auto step = device_radius > tolerance ? 2.0f * acosf(1.0f - tolerance / device_radius) : PI;
+                auto n = max(1, min(MAX_SEGMENTS, (int32_t)ceilf(fabsf(sweep) / step)));
+
+                auto& points = contours.back().points;
+                for (int32_t i = 1; i <= n; i++)
+                {
+                    float angle = angles.x + sweep * i / n;
+                    points.emplace_back(center.x + cosf(angle) * radius, center.y + sinf(angle) * radius);
+                }
+
+                current = points.back();
+                break;
+            }
+
+            case Command::Close:
+            {
+                if (contours.empty() || contours.back().closed)
+                    break;
+
+                //the closing segment is implied, drop a duplicate of the first point
+                auto& points = contours.back().points;
+                if (points.size() > 1 && points.back() == points.front())
+                    points.pop_back();
+
+                contours.back().closed = true;
+                current = start;
+                break;
+            }
+        }
+    }
+
+    //a lone move doesn't draw anything
+    contours.erase(remove_if(contours.begin(), contours.end(), [](const PathContour& c) { return c.points.size() < 2; }), contours.end());
+}
+
+void Path::build(const vector<PathContour>& contours, PathFill& fill)
+{
+    fill.points.clear();
+    fill.indices.clear();
+    fill.bounds = fvec4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    fill.stencil = false;
+
+    //open contours are filled as if closed
+    size_t rings = 0;
+    for (auto& contour : contours)
+    {
+        if (contour.points.size() < 3)
+            continue;
+
+        auto base = (uint32_t)fill.points.size();
+        fill.points.insert(fill.points.end(), contour.points.begin(), contour.points.end());
+        triangulate_fan(contour.points.size(), base, fill.indices);
+        rings++;
+
+        for (auto& point : contour.points)
+        {
+            fill.bounds.x = min(fill.bounds.x, point.x);
+            fill.bounds.y = min(fill.bounds.y, point.y);
+            fill.bounds.z = max(fill.bounds.z, point.x);
+            fill.bounds.w = max(fill.bounds.w, point.y);
+        }
+    }
+
+    if (rings == 0)
+    {
+        fill.bounds = fvec4();
+        return;
+    }
+
+    //the fans are already exact for a single convex ring
+    if (rings == 1 && polygon_convex(fill.points.data(), fill.points.size()))
+        return;
+
+    if (rings == 1 && fill.points.size() <= MAX_TRIANGULATE_POINTS && polygon_simple(fill.points.data(), fill.points.size()))
+    {
+        vector<uint32_t> indices;
+        if (triangulate(fill.points.data(), fill.points.size(), 0, indices))
+        {
+            fill.indices = move(indices);
+            return;
+        }
+    }
+
+    fill.stencil = true;
+}
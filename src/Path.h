@@ -0,0 +1,84 @@
+#ifndef _PATH_H_
+#define _PATH_H_
+
+#include "Config.h"
+
+enum class FillRule
+{
+    NonZero,
+    EvenOdd
+};
+
+struct PathContour
+{
+    vector<fvec2> points;
+    bool closed;
+};
+
+//triangles covering the path, or with stencil set fans that only cover the right
+//pixels when drawn with stencil-then-cover under the fill rule
+struct PathFill
+{
+    vector<fvec2> points;
+    vector<uint32_t> indices;
+    fvec4 bounds;
+    bool stencil;
+};
+
+//Vector path made of lines, beziers and arcs. Curves are flattened on demand
+//with just enough segments to stay within tolerance device pixels at the
+//given scale, results are kept per quarter octave of scale until the path changes.
+class Path
+{
+private:
+    static const int32_t MAX_CACHED = 4;
+
+    enum class Command
+    {
+        Move,
+        Line,
+        Quad,
+        Cubic,
+        Arc,
+        Close
+    };
+
+    struct Flattened
+    {
+        int32_t bucket;
+        float tolerance;
+        uint32_t version;
+        vector<PathContour> contours;
+        bool filled;
+        PathFill fill;
+    };
+
+    vector<Command> m_commands;
+    vector<fvec2> m_points;
+    uint32_t m_version;
+    vector<Flattened> m_cache;
+public:
+    Path();
+    ~Path();
+
+    void move_to(float x, float y);
+    void line_to(float x, float y);
+    void quad_to(float cx, float cy, float x, float y);
+    void cubic_to(float c1x, float c1y, float c2x, float c2y, float x, float y);
+    //angles in radians, continues the current contour with a line to the arc's start
+    void arc(float cx, float cy, float radius, float start, float end);
+    void close();
+    void clear();
+
+    bool empty();
+    uint32_t get_version();
+    const vector<PathContour>& flatten(float scale, float tolerance);
+    //single simple contours are triangulated, anything with holes or crossings needs the stencil
+    const PathFill& fill(float scale, float tolerance);
+private:
+    Flattened& lookup(float scale, float tolerance);
+    void build(float scale, float tolerance, vector<PathContour>& contours);
+    void build(const vector<PathContour>& contours, PathFill& fill);
+};
+
+#endif
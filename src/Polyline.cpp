@@ -0,0 +1,178 @@
+#include "Polyline.h"
+
+static int32_t intersect(fvec2 P1, fvec2 P2, fvec2 P3, fvec2 P4, fvec2& Pout)
+{
+    float mua = 0.0f;
+    float mub = 0.0f;
+    float denom = 0.0f;
+    float numera = 0.0f;
+    float numerb = 0.0f;
+    float eps = 0.000000000001f;
+
+    denom = (P4.y - P3.y) * (P2.x - P1.x) - (P4.x - P3.x) * (P2.y - P1.y);
+    numera = (P4.x - P3.x) * (P1.y - P3.y) - (P4.y - P3.y) * (P1.x - P3.x);
+    numerb = (P2.x - P1.x) * (P1.y - P3.y) - (P2.y - P1.y) * (P1.x - P3.x);
+    if ((-eps < numera && numera < eps) && (-eps < numerb && numerb < eps) && (-eps < denom  && denom  < eps))
+    {
+        Pout.x = (P1.x + P2.x) * 0.5f;
+        Pout.y = (P1.y + P2.y) * 0.5f;
+        return 2; //meaning the lines coincide
+    }
+    if (-eps < denom  && denom  < eps)
+    {
+        Pout.x = 0;
+        Pout.y = 0;
+        return 0; //meaning lines are parallel
+    }
+    mua = numera / denom;
+    mub = numerb / denom;
+    Pout.x = P1.x + mua * (P2.x - P1.x);
+    Pout.y = P1.y + mua * (P2.y - P1.y);
+    bool out1 = mua < 0 || mua > 1;
+    bool out2 = mub < 0 || mub > 1;
+
+    if (out1 && out2)
+    {
+        return 5; //the intersection lies outside both segments
+    }
+    else if (out1)
+    {
+        return 3; //the intersection lies outside segment 1
+    }
+    else if (out2)
+    {
+        return 4; //the intersection lies outside segment 2
+    }
+    else
+    {
+        return 1; //the intersection lies inside both segments
+    }
+}
+
+size_t polyline_pieces(size_t count, bool closed)
+{
+    if (count <= 1)
+        return 0;
+
+    if (count == 2)
+        return 1;
+
+    return closed ? count : count - 2;
+}
+
+size_t polyline_vertices(size_t count, size_t pieces)
+{
+    return count == 2 ? 4 : pieces * POLYLINE_PIECE_VERTICES;
+}
+
+size_t polyline_indices(size_t count, size_t pieces)
+{
+    return count == 2 ? 6 : pieces * POLYLINE_PIECE_INDICES;
+}
+
+static inline fvec2 midpoint(const fvec2& a, const fvec2& b)
+{
+    return fvec2(a.x + (b.x - a.x) * 0.5f, a.y + (b.y - a.y) * 0.5f);
+}
+
+static void segment(const fvec2& a, const fvec2& b, float strength, VertexData* vertices, uint32_t* indices)
+{
+    float nx = -(b.y - a.y);
+    float ny = b.x - a.x;
+    float length = sqrtf((nx * nx) + (ny * ny));
+    nx /= length;
+    ny /= length;
+
+    vertices[0] = VertexData(fvec2(a.x + nx * strength, a.y + ny * strength));
+    vertices[1] = VertexData(fvec2(a.x - nx * strength, a.y - ny * strength));
+    vertices[2] = VertexData(fvec2(b.x + nx * strength, b.y + ny * strength));
+    vertices[3] = VertexData(fvec2(b.x - nx * strength, b.y - ny * strength));
+
+    static const uint32_t quad[6] = { 0, 2, 3, 3, 1, 0 };
+    memcpy(indices, quad, sizeof(quad));
+}
+
+//one joint, from halfway along the incoming segment to halfway along the outgoing one
+static void joint(const fvec2& previous, const fvec2& current, const fvec2& next, float strength, uint32_t base, VertexData* vertices, uint32_t* indices)
+{
+    float n0x = -(current.y - previous.y);
+    float n0y = current.x - previous.x;
+    float n2x = -(next.y - current.y);
+    float n2y = next.x - current.x;
+    float length0 = sqrtf((n0x * n0x) + (n0y * n0y));
+    float length2 = sqrtf((n2x * n2x) + (n2y * n2y));
+
+    n0x /= length0;
+    n0y /= length0;
+    n2x /= length2;
+    n2y /= length2;
+
+    fvec2 t0(previous.x - n0x * strength, previous.y - n0y * strength);
+    fvec2 mint0(previous.x + n0x * strength, previous.y + n0y * strength);
+    fvec2 t2(next.x - n2x * strength, next.y - n2y * strength);
+    fvec2 mint2(next.x + n2x * strength, next.y + n2y * strength);
+    fvec2 at(current.x - n0x * strength, current.y - n0y * strength);
+    fvec2 bt(current.x - n2x * strength, current.y - n2y * strength);
+
+    //segments folding back onto themselves have no miter point
+    fvec2 vp;
+    if (intersect(t0, at, t2, bt, vp) == 0)
+        vp = midpoint(at, bt);
+
+    fvec2 minvp(current.x - (vp.x - current.x), current.y - (vp.y - current.y));
+
+    vertices[0] = VertexData(t0);
+    vertices[1] = VertexData(mint0);
+    vertices[2] = VertexData(t2);
+    vertices[3] = VertexData(mint2);
+    vertices[4] = VertexData(at);
+    vertices[5] = VertexData(bt);
+    vertices[6] = VertexData(vp);
+    vertices[7] = VertexData(minvp);
+
+    static const uint32_t pattern[POLYLINE_PIECE_INDICES] = {
+        0, 4, 7, 0, 7, 1,
+        4, 6, 5, 4, 5, 7,
+        5, 2, 7, 2, 3, 7
+    };
+
+    for (size_t i = 0; i < POLYLINE_PIECE_INDICES; i++)
+        indices[i] = base + pattern[i];
+}
+
+void polyline(const fvec2* points, size_t count, bool closed, float strength, size_t first, size_t pieces, VertexData* vertices, uint32_t* indices)
+{
+    if (count <= 1 || pieces == 0)
+        return;
+
+    if (count == 2)
+    {
+        segment(points[0], points[1], strength, vertices, indices);
+        return;
+    }
+
+    //joints meet halfway along each segment, open lines start and end on their endpoints instead
+    for (size_t piece = first; piece < first + pieces; piece++)
+    {
+        fvec2 previous;
+        fvec2 current;
+        fvec2 next;
+
+        if (closed)
+        {
+            current = points[piece];
+            previous = midpoint(points[piece == 0 ? count - 1 : piece - 1], current);
+            next = midpoint(current, points[piece == count - 1 ? 0 : piece + 1]);
+        }
+        else
+        {
+            auto i = piece + 1;
+            current = points[i];
+            previous = i == 1 ? points[0] : midpoint(points[i - 1], current);
+            next = i == count - 2 ? points[count - 1] : midpoint(current, points[i + 1]);
+        }
+
+        auto offset = (piece - first) * POLYLINE_PIECE_VERTICES;
+        joint(previous, current, next, strength, (uint32_t)offset, vertices + offset, indices + (piece - first) * POLYLINE_PIECE_INDICES);
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef _POLYLINE_H_
+#define _POLYLINE_H_
+
+#include "Config.h"
+#include "Canvas.h"
+
+//A polyline is tessellated as independent pieces, one per joint, so any range
+//of pieces can be written straight into batch memory. A single segment is one
+//plain quad instead.
+static const size_t POLYLINE_PIECE_VERTICES = 8;
+static const size_t POLYLINE_PIECE_INDICES = 18;
+
+size_t polyline_pieces(size_t count, bool closed);
+size_t polyline_vertices(size_t count, size_t pieces);
+size_t polyline_indices(size_t count, size_t pieces);
+
+//writes pieces [first, first + pieces) to vertices and indices, indices start at 0 for the first vertex written
+void polyline(const fvec2* points, size_t count, bool closed, float strength, size_t first, size_t pieces, VertexData* vertices, uint32_t* indices);
+
+#endif
@@ -0,0 +1,213 @@
+#include "ProgramCache.h"
+#include "LogSystem.h"
+#include "Hash.h"
+
+#include <filesystem>
+
+static FILE* open_file(const string& path, const char* mode)
+{
+    FILE* fp = nullptr;
+
+#ifdef _WIN32
+    fopen_s(&fp, path.c_str(), mode);
+#else
+    fp = fopen(path.c_str(), mode);
+#endif
+
+    return fp;
+}
+
+static float elapsed_ms(uint64_t start)
+{
+    return (float)((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+ProgramCache::ProgramCache(const string& directory) :
+    m_directory(directory), m_driver_hash(0), m_supported(-1), m_stats()
+{
+    if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\')
+        m_directory += '/';
+}
+
+ProgramCache::~ProgramCache()
+{
+}
+
+uint32_t ProgramCache::load(const string& vertex, const string& fragment)
+{
+    if (!supported())
+        return 0;
+
+    auto start = SDL_GetPerformanceCounter();
+    auto key = get_key(vertex, fragment);
+    auto path = get_path(key);
+
+    auto fp = open_file(path, "rb");
+    if (fp == nullptr)
+    {
+        m_stats.misses++;
+        return 0;
+    }
+
+    Header header = {};
+    vector<uint8_t> binary;
+
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == MAGIC && header.key == key;
+    if (valid)
+    {
+        binary.resize(header.size);
+        valid = header.size > 0 && fread(binary.data(), 1, binary.size(), fp) == binary.size();
+    }
+
+    fclose(fp);
+
+    uint32_t program = 0;
+    if (valid)
+    {
+        program = glCreateProgram();
+        CHECK_GL_ERROR;
+
+        //a binary the driver no longer accepts shows up as a failed link
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+        int32_t success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        CHECK_GL_ERROR;
+
+        if (success == GL_FALSE)
+        {
+            glDeleteProgram(program);
+            CHECK_GL_ERROR;
+            program = 0;
+        }
+    }
+
+    if (program == 0)
+    {
+        LogSystem::get()->warn("Discarding stale program binary %s", path.c_str());
+        remove(path.c_str());
+
+        m_stats.rejected++;
+        m_stats.misses++;
+        return 0;
+    }
+
+    auto load_ms = elapsed_ms(start);
+    m_stats.hits++;
+    m_stats.load_ms += load_ms;
+    m_stats.saved_ms += max(0.0f, header.compile_ms - load_ms);
+
+    return program;
+}
+
+void ProgramCache::store(uint32_t program, const string& vertex, const string& fragment, float compile_ms)
+{
+    m_stats.compile_ms += compile_ms;
+
+    if (!supported())
+        return;
+
+    int32_t size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    CHECK_GL_ERROR;
+
+    if (size <= 0)
+        return;
+
+    Header header = {};
+    vector<uint8_t> binary(size);
+
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &size, &format, binary.data());
+    CHECK_GL_ERROR;
+
+    header.magic = MAGIC;
+    header.format = format;
+    header.size = (uint32_t)size;
+    header.compile_ms = compile_ms;
+    header.key = get_key(vertex, fragment);
+
+    //a fresh install starts without the directory
+    error_code error;
+    filesystem::create_directories(m_directory, error);
+    if (error)
+    {
+        LogSystem::get()->warn("Failed to create program cache directory %s: %s", m_directory.c_str(), error.message().c_str());
+        return;
+    }
+
+    auto path = get_path(header.key);
+    auto fp = open_file(path, "wb");
+    if (fp == nullptr)
+    {
+        LogSystem::get()->warn("Failed to write program binary %s", path.c_str());
+        return;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(binary.data(), 1, header.size, fp) == header.size;
+    fclose(fp);
+
+    //never leave a truncated entry behind, the next launch would only reject it
+    if (!written)
+    {
+        remove(path.c_str());
+        return;
+    }
+
+    m_stats.stored++;
+}
+
+bool ProgramCache::supported()
+{
+    if (m_supported == -1)
+    {
+        int32_t formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        CHECK_GL_ERROR;
+
+        m_supported = formats > 0 && !m_directory.empty() ? 1 : 0;
+    }
+
+    return m_supported == 1;
+}
+
+const string& ProgramCache::get_directory()
+{
+    return m_directory;
+}
+
+const ProgramCacheStats& ProgramCache::get_stats()
+{
+    return m_stats;
+}
+
+uint64_t ProgramCache::get_key(const string& vertex, const string& fragment)
+{
+    //a driver update invalidates every binary, fold the driver strings into each key
+    if (m_driver_hash == 0)
+    {
+        uint64_t hash = HASH_OFFSET_BASIS;
+        for (auto name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        {
+            auto str = (const char*)glGetString(name);
+            CHECK_GL_ERROR;
+
+            if (str != nullptr)
+                hash = hash_bytes(str, strlen(str), hash);
+        }
+
+        m_driver_hash = hash;
+    }
+
+    auto hash = hash_bytes(vertex.data(), vertex.size(), m_driver_hash);
+    hash = hash_value(vertex.size(), hash);
+    return hash_bytes(fragment.data(), fragment.size(), hash);
+}
+
+string ProgramCache::get_path(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+
+    return m_directory + name;
+}
@@ -0,0 +1,53 @@
+#ifndef _PROGRAM_CACHE_H_
+#define _PROGRAM_CACHE_H_
+
+#include "Config.h"
+
+struct ProgramCacheStats
+{
+    int32_t hits;
+    int32_t misses;
+    int32_t rejected;
+    int32_t stored;
+    float compile_ms;
+    float load_ms;
+    float saved_ms;
+};
+
+//Keeps linked program binaries in a directory so later launches can skip
+//compiling. Entries are keyed by the sources and the driver strings, a binary
+//the driver refuses is dropped and the caller compiles from source again.
+class ProgramCache
+{
+private:
+    static const uint32_t MAGIC = 0x50524743;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t format;
+        uint32_t size;
+        float compile_ms;
+        uint64_t key;
+    };
+
+    string m_directory;
+    uint64_t m_driver_hash;
+    int32_t m_supported;
+    ProgramCacheStats m_stats;
+public:
+    ProgramCache(const string& directory);
+    ~ProgramCache();
+
+    uint32_t load(const string& vertex, const string& fragment);
+    void store(uint32_t program, const string& vertex, const string& fragment, float compile_ms);
+    bool supported();
+
+    const string& get_directory();
+    const ProgramCacheStats& get_stats();
+private:
+    uint64_t get_key(const string& vertex, const string& fragment);
+    string get_path(uint64_t key);
+};
+
+#endif
@@ -1,83 +1,178 @@
 #include "RenderLayer.h"
 #include "LogSystem.h"
-
-RenderLayer::RenderLayer(Canvas* canvas, unsigned int vertex_buffer, unsigned int index_buffer) :
-    m_canvas(canvas), m_texture(), m_vertex_buffer(vertex_buffer), m_index_buffer(index_buffer), m_current_index(), m_current_vertex(),
+#include "StaticMesh.h"
+#include "GLState.h"
+
+RenderLayer::RenderLayer(Canvas* canvas, VertexArena* vertex_arena, IndexArena* index_arena, InstanceArena* instance_arena) :
+    m_canvas(canvas), m_vertex_arena(vertex_arena), m_index_arena(index_arena), m_instance_arena(instance_arena), m_instanced(false),
+    m_mesh(), m_model(), m_tint(), m_stencil(false), m_fill_rule(FillRule::NonZero),
+    m_spans(), m_bounds(), m_current_index(), m_current_vertex(), m_current_instance(),
+    m_vertex_base(), m_index_offset(), m_instance_offset(), m_depth(), m_texture(), m_texture_ids(), m_texture_count(),
     m_scissor(), m_scissor_x(), m_scissor_y(), m_scissor_width(), m_scissor_height()
 {
-    m_vertex_data = UNEW_0(VertexArray);
-    m_index_data = UNEW_0(IndexArray);
 }
 
 RenderLayer::~RenderLayer()
 {
 }
 
-bool RenderLayer::draw(const vector<VertexData>& vertices, const vector<unsigned short>& indices, bool flipped_y)
+bool RenderLayer::draw(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const uint16_t* indices, size_t index_count, const VertexTransform& transform)
 {
-    auto vsz = vertices.size();
-    auto isz = indices.size();
+    return append(texture, vertices, vertex_count, indices, index_count, transform);
+}
 
-    if (vsz == 0 || isz == 0)
+bool RenderLayer::draw(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count, const VertexTransform& transform)
+{
+    return append(texture, vertices, vertex_count, indices, index_count, transform);
+}
+
+bool RenderLayer::draw(TexturePtr texture, const SpriteInstance& instance)
+{
+    if (!m_instanced || m_current_instance >= MAX_NUM_INSTANCES)
+        return false;
+
+    int32_t slot = find_slot(texture);
+    if (slot == -1)
+        return false;
+
+    if (texture != nullptr && slot == m_texture_count)
+        m_texture_ids[m_texture_count++] = texture->get_id();
+
+    auto start = m_instance_arena->allocate(1);
+    add_span(start, 1, 0, 0);
+
+    auto* target = m_instance_arena->data(start);
+    *target = instance;
+    target->slot = (uint32_t)slot;
+
+    m_current_instance++;
+    return true;
+}
+
+bool RenderLayer::draw(StaticMeshPtr mesh, const fmatrix4& model, const fvec4& tint)
+{
+    //a mesh always gets a layer of its own
+    if (m_mesh != nullptr || m_instanced || m_current_vertex > 0)
+        return false;
+
+    if (mesh->get_texture() != nullptr)
+        m_texture_ids[m_texture_count++] = mesh->get_texture()->get_id();
+
+    m_mesh = mesh;
+    m_model = model;
+    m_tint = tint;
+
+    return true;
+}
+
+bool RenderLayer::claim(TexturePtr texture, size_t vertex_start, size_t vertex_count, size_t index_start, size_t index_count)
+{
+    if (vertex_count == 0 || index_count == 0)
         return true;
 
-    auto color = m_canvas->get_state()->color();
-    auto transform = m_canvas->get_state()->matrix();
-    auto opacity = m_canvas->get_state()->opacity();
+    if (m_current_vertex + vertex_count > MAX_NUM_VERTICES || m_current_index + index_count > MAX_NUM_INDICES)
+        return false;
 
-    if (m_current_vertex + vsz >= MAX_NUM_PRIMITIVES * 3 || m_current_index + floor(isz / 3.0f) >= MAX_NUM_PRIMITIVES)
+    if (m_instanced || m_mesh != nullptr || m_stencil)
         return false;
 
-    int baseIndex = m_current_vertex;
-    int offset = m_current_vertex;
+    int32_t slot = find_slot(texture);
+    if (slot == -1)
+        return false;
+
+    if (texture != nullptr && slot == m_texture_count)
+        m_texture_ids[m_texture_count++] = texture->get_id();
 
-    float _00 = transform[0][0];
-    float _01 = transform[0][1];
-    float _10 = transform[1][0];
-    float _11 = transform[1][1];
-    float _30 = transform[3][0];
-    float _31 = transform[3][1];
+    add_span(vertex_start, (int32_t)vertex_count, index_start, (int32_t)index_count);
 
-    auto* data = &(*m_vertex_data)[0];
-    auto* verts = vertices.data();
-    for (int i = 0; i < vsz; i++)
+    if (slot != 0)
     {
-        auto& vert = verts[i];
-        auto& target = data[offset++];
+        auto* vertex_data = m_vertex_arena->data(vertex_start);
+        for (size_t i = 0; i < vertex_count; i++)
+            vertex_data[i].slot = (uint32_t)slot;
+    }
 
-        target.v.x = _00 * vert.v.x + _10 * vert.v.y + _30;
-        target.v.y = _01 * vert.v.x + _11 * vert.v.y + _31;
-        target.uv.x = vert.uv.x;
-        target.uv.y = vert.uv.y;
-        target.color = (color * vert.color * opacity).uint;
+    auto* index_data = m_index_arena->data(index_start);
+    for (size_t i = 0; i < index_count; i++)
+        index_data[i] += m_current_vertex;
 
-        if (flipped_y)
-            target.v.y = m_canvas->get_viewport_height() - target.v.y;
-    }
+    m_current_vertex += (int32_t)vertex_count;
+    m_current_index += (int32_t)index_count;
+
+    return true;
+}
+
+bool RenderLayer::stencil(size_t vertex_start, size_t vertex_count, size_t index_start, size_t index_count, FillRule rule)
+{
+    if (m_current_vertex > 0 || m_texture != nullptr || !claim(nullptr, vertex_start, vertex_count, index_start, index_count))
+        return false;
+
+    m_stencil = true;
+    m_fill_rule = rule;
+
+    return true;
+}
+
+template<typename T>
+bool RenderLayer::append(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, const VertexTransform& transform)
+{
+    auto vsz = vertex_count;
+    auto isz = index_count;
+
+    if (vsz == 0 || isz == 0)
+        return true;
+
+    if (m_current_vertex + vsz > MAX_NUM_VERTICES || m_current_index + isz > MAX_NUM_INDICES)
+        return false;
+
+    if (m_instanced || m_mesh != nullptr || m_stencil)
+        return false;
+
+    int32_t slot = find_slot(texture);
+    if (slot == -1)
+        return false;
+
+    if (texture != nullptr && slot == m_texture_count)
+        m_texture_ids[m_texture_count++] = texture->get_id();
 
-    offset = m_current_index * 3;
-    auto* index_data = &(*m_index_data)[0];
-    auto* idxs = indices.data();
+    int baseIndex = m_current_vertex;
+
+    VertexTransform slot_transform = transform;
+    slot_transform.slot = (uint32_t)slot;
+
+    auto vertex_start = m_vertex_arena->allocate(vsz);
+    auto index_start = m_index_arena->allocate(isz);
+    add_span(vertex_start, (int32_t)vsz, index_start, (int32_t)isz);
 
-    for (int i = 0; i<isz; i++)
+    transform_vertices(slot_transform, vertices, m_vertex_arena->data(vertex_start), vsz);
+
+    int offset = 0;
+    auto* index_data = m_index_arena->data(index_start);
+    for (size_t i = 0; i<isz; i++)
     {
-        index_data[offset++] = baseIndex + idxs[i];
+        index_data[offset++] = baseIndex + indices[i];
     }
 
     m_current_vertex += (int)vsz;
-    m_current_index += (int)(isz / 3.0f);
+    m_current_index += (int)isz;
 
     return true;
 }
 
 bool RenderLayer::validate(TexturePtr texture, ShaderPtr shader)
 {
-    if (m_texture != texture)
+    if (m_mesh != nullptr || m_stencil)
+        return false;
+
+    if (m_depth != m_canvas->get_depth())
         return false;
 
     if (m_shader != shader)
         return false;
 
+    if (find_slot(texture) == -1)
+        return false;
+
     if (m_scissor != m_canvas->scissor_test())
         return false;
 
@@ -99,11 +194,35 @@ bool RenderLayer::validate(TexturePtr texture, ShaderPtr shader)
     return true;
 }
 
+bool RenderLayer::overlaps(const fvec4& bounds)
+{
+    return bounds.x < m_bounds.z && bounds.z > m_bounds.x && bounds.y < m_bounds.w && bounds.w > m_bounds.y;
+}
+
+void RenderLayer::extend(const fvec4& bounds)
+{
+    if (m_bounds.x >= m_bounds.z || m_bounds.y >= m_bounds.w)
+    {
+        m_bounds = bounds;
+        return;
+    }
+
+    m_bounds.x = min(m_bounds.x, bounds.x);
+    m_bounds.y = min(m_bounds.y, bounds.y);
+    m_bounds.z = max(m_bounds.z, bounds.z);
+    m_bounds.w = max(m_bounds.w, bounds.w);
+}
+
 bool RenderLayer::texture()
 {
     return m_texture.get() != nullptr;
 }
 
+bool RenderLayer::instanced()
+{
+    return m_instanced;
+}
+
 bool RenderLayer::scissor_test()
 {
     return m_scissor;
@@ -129,6 +248,51 @@ float RenderLayer::get_scissor_height()
     return m_scissor_height;
 }
 
+int32_t RenderLayer::get_vertex_count()
+{
+    return m_current_vertex;
+}
+
+int32_t RenderLayer::get_index_count()
+{
+    return m_current_index;
+}
+
+int32_t RenderLayer::get_free_vertices()
+{
+    return MAX_NUM_VERTICES - m_current_vertex;
+}
+
+int32_t RenderLayer::get_free_indices()
+{
+    return MAX_NUM_INDICES - m_current_index;
+}
+
+int32_t RenderLayer::get_depth()
+{
+    return m_depth;
+}
+
+const fvec4& RenderLayer::get_bounds()
+{
+    return m_bounds;
+}
+
+int32_t RenderLayer::get_index_size()
+{
+    return m_current_vertex > MAX_SHORT_VERTICES ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
+int32_t RenderLayer::get_instance_count()
+{
+    return m_current_instance;
+}
+
+size_t RenderLayer::get_instance_offset()
+{
+    return m_instance_offset;
+}
+
 TexturePtr RenderLayer::get_texture()
 {
     return m_texture;
@@ -139,16 +303,36 @@ ShaderPtr RenderLayer::get_shader()
     return m_shader;
 }
 
-void RenderLayer::reset(TexturePtr texture, ShaderPtr shader)
+StaticMeshPtr RenderLayer::get_mesh()
+{
+    return m_mesh;
+}
+
+const fmatrix4& RenderLayer::get_model()
+{
+    return m_model;
+}
+
+const fvec4& RenderLayer::get_tint()
+{
+    return m_tint;
+}
+
+void RenderLayer::reset(TexturePtr texture, ShaderPtr shader, bool instanced)
 {
     m_texture = texture;
+    m_texture_count = 0;
     m_shader = shader;
+    m_instanced = instanced;
+    m_mesh = nullptr;
+    m_stencil = false;
 
+    m_spans.clear();
+    m_bounds = fvec4();
     m_current_index = 0;
     m_current_vertex = 0;
-
-    memset(&(*m_vertex_data)[0], 0, m_vertex_data->size() * sizeof(VertexData));
-    memset(&(*m_index_data)[0], 0, m_index_data->size() * sizeof(unsigned short));
+    m_current_instance = 0;
+    m_depth = m_canvas->get_depth();
 
     m_scissor = m_canvas->scissor_test();
     m_scissor_x = m_canvas->get_scissor_x();
@@ -157,46 +341,173 @@ void RenderLayer::reset(TexturePtr texture, ShaderPtr shader)
     m_scissor_height = m_canvas->get_scissor_height();
 }
 
-void RenderLayer::upload(int va, int ca)
+void RenderLayer::upload(VertexData* vertices, uint8_t* indices, int32_t vertex_base, size_t index_offset)
 {
+    m_vertex_base = vertex_base;
+    m_index_offset = index_offset;
+
     if (m_current_vertex == 0 || m_current_index == 0)
         return;
 
-    glActiveTexture(GL_TEXTURE0);
-    CHECK_GL_ERROR;
-    glBindTexture(GL_TEXTURE_2D, m_texture == nullptr ? 0 : (GLuint)m_texture->get_id());
-    CHECK_GL_ERROR;
+    auto index_size = get_index_size();
+    for (auto& span : m_spans)
+    {
+        memcpy(vertices, m_vertex_arena->data(span.vertex_start), sizeof(VertexData) * span.vertex_count);
+        vertices += span.vertex_count;
+
+        auto* index_data = m_index_arena->data(span.index_start);
+        if (index_size == sizeof(uint32_t))
+        {
+            memcpy(indices, index_data, sizeof(uint32_t) * span.index_count);
+        }
+        else
+        {
+            auto* target = (uint16_t*)indices;
+            for (int i = 0; i < span.index_count; i++)
+                target[i] = (uint16_t)index_data[i];
+        }
+
+        indices += index_size * span.index_count;
+    }
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
-    CHECK_GL_ERROR;
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
-    CHECK_GL_ERROR;
+void RenderLayer::upload(SpriteInstance* instances, size_t instance_offset)
+{
+    m_instance_offset = instance_offset;
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexData) * m_current_vertex, &(*m_vertex_data)[0], GL_STREAM_DRAW);
-    CHECK_GL_ERROR;
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short) * m_current_index * 3, &(*m_index_data)[0], GL_STREAM_DRAW);
-    CHECK_GL_ERROR;
+    for (auto& span : m_spans)
+    {
+        memcpy(instances, m_instance_arena->data(span.vertex_start), sizeof(SpriteInstance) * span.vertex_count);
+        instances += span.vertex_count;
+    }
+}
 
-#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
-    glVertexAttribPointer(va, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, v));
-    CHECK_GL_ERROR;
-    glVertexAttribPointer(ca, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, color));
+void RenderLayer::render(const ivec4* clip)
+{
+    if (m_mesh == nullptr && (m_instanced ? m_current_instance == 0 : m_current_vertex == 0 || m_current_index == 0))
+        return;
+
+    if (m_scissor || clip != nullptr)
+    {
+        //damage regions are applied on top of the layer's own scissor
+        ivec4 rect = clip != nullptr ? ivec4(clip->x, clip->y, clip->x + clip->z, clip->y + clip->w) : ivec4(INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX);
+        if (m_scissor)
+        {
+            rect.x = max(rect.x, (int32_t)m_scissor_x);
+            rect.y = max(rect.y, (int32_t)m_scissor_y);
+            rect.z = min(rect.z, (int32_t)(m_scissor_x + m_scissor_width));
+            rect.w = min(rect.w, (int32_t)(m_scissor_y + m_scissor_height));
+        }
+
+        if (rect.x >= rect.z || rect.y >= rect.w)
+            return;
+
+        GLState::get()->set_scissor(true, rect.x, rect.y, rect.z - rect.x, rect.w - rect.y);
+    }
+    else
+    {
+        GLState::get()->set_scissor(false);
+    }
+
+    //units stay bound after the draw, the next layer usually samples the same pages
+    for (int32_t i = 0; i < m_texture_count; i++)
+        GLState::get()->bind_texture(i, (uint32_t)m_texture_ids[i]);
+
+    if (m_mesh != nullptr)
+    {
+        m_mesh->render();
+    }
+    else if (m_instanced)
+    {
+        //the unit quad and the instance attributes are bound by the canvas
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, m_current_instance);
+        CHECK_GL_ERROR;
+    }
+    else if (m_stencil)
+    {
+        render_stencil();
+    }
+    else
+    {
+        auto type = get_index_size() == sizeof(uint32_t) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        glDrawElementsBaseVertex(GL_TRIANGLES, m_current_index, type, (GLvoid*)m_index_offset, m_vertex_base);
+        CHECK_GL_ERROR;
+    }
+}
+
+void RenderLayer::render_stencil()
+{
+    auto type = get_index_size() == sizeof(uint32_t) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    auto fan_indices = m_current_index - 6;
+
+    //the fans count coverage into the stencil without touching color
+    GLState::get()->set_stencil_test(true);
+    GLState::get()->set_color_mask(false);
+
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
     CHECK_GL_ERROR;
-#undef OFFSETOF
 
-    if (m_scissor)
+    if (m_fill_rule == FillRule::EvenOdd)
     {
-        glEnable(GL_SCISSOR_TEST);
-        glScissor((GLint)m_scissor_x, (GLint)m_scissor_y, (GLsizei)m_scissor_width, (GLsizei)m_scissor_height);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+        CHECK_GL_ERROR;
     }
     else
     {
-        glDisable(GL_SCISSOR_TEST);
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+        CHECK_GL_ERROR;
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+        CHECK_GL_ERROR;
     }
 
-    glDrawElements(GL_TRIANGLES, m_current_index * 3, GL_UNSIGNED_SHORT, 0);
+    glDrawElementsBaseVertex(GL_TRIANGLES, fan_indices, type, (GLvoid*)m_index_offset, m_vertex_base);
+    CHECK_GL_ERROR;
+
+    //the cover quad shades covered pixels and clears the stencil behind itself for the next fill
+    GLState::get()->set_color_mask(true);
+
+    glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+    CHECK_GL_ERROR;
+    glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
     CHECK_GL_ERROR;
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glDrawElementsBaseVertex(GL_TRIANGLES, 6, type, (GLvoid*)(m_index_offset + fan_indices * get_index_size()), m_vertex_base);
     CHECK_GL_ERROR;
+
+    GLState::get()->set_stencil_test(false);
+}
+
+int32_t RenderLayer::find_slot(TexturePtr texture)
+{
+    //untextured and textured geometry never share a layer
+    if (texture == nullptr || m_texture == nullptr)
+        return texture == m_texture ? 0 : -1;
+
+    auto id = texture->get_id();
+    for (int32_t i = 0; i < m_texture_count; i++)
+    {
+        if (m_texture_ids[i] == id)
+            return i;
+    }
+
+    if (m_texture_count < min(m_shader->get_texture_slots(), MAX_TEXTURE_SLOTS))
+        return m_texture_count;
+
+    return -1;
+}
+
+void RenderLayer::add_span(size_t vertex_start, int32_t vertex_count, size_t index_start, int32_t index_count)
+{
+    if (!m_spans.empty())
+    {
+        auto& last = m_spans.back();
+        if (last.vertex_start + last.vertex_count == vertex_start && last.index_start + last.index_count == index_start)
+        {
+            last.vertex_count += vertex_count;
+            last.index_count += index_count;
+            return;
+        }
+    }
+
+    m_spans.push_back({ vertex_start, index_start, vertex_count, index_count });
 }
\ No newline at end of file
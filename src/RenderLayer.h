@@ -3,43 +3,81 @@
 
 #include "Config.h"
 #include "Canvas.h"
+#include "VertexKernel.h"
 
 class RenderLayer
 {
+public:
+    static const int32_t MAX_NUM_VERTICES = 1 << 20;
+    static const int32_t MAX_NUM_INDICES = MAX_NUM_VERTICES * 3;
+    static const int32_t MAX_TEXTURE_SLOTS = 8;
+    static const int32_t MAX_NUM_INSTANCES = 1 << 16;
 private:
-    static const int32_t MAX_NUM_PRIMITIVES = 8192;
+    static const int32_t MAX_SHORT_VERTICES = 0xFFFF;
 
-    using VertexArray = array<VertexData, MAX_NUM_PRIMITIVES * 3>;
-    using IndexArray = array<uint16_t, MAX_NUM_PRIMITIVES * 3>;
-    using VertexArrayPtr = UPTR(VertexArray);
-    using IndexArrayPtr = UPTR(IndexArray);
+    //range of the arenas owned by this layer, a layer that receives geometry
+    //after other layers were opened ends up with more than one span. Instanced
+    //layers keep their range of the instance arena in the vertex fields
+    struct Span
+    {
+        size_t vertex_start;
+        size_t index_start;
+        int32_t vertex_count;
+        int32_t index_count;
+    };
 
     Canvas* m_canvas;
+    VertexArena* m_vertex_arena;
+    IndexArena* m_index_arena;
+    InstanceArena* m_instance_arena;
+    ShaderPtr m_shader;
+    bool m_instanced;
 
-    uint32_t m_vertex_buffer;
-    uint32_t m_index_buffer;
+    StaticMeshPtr m_mesh;
+    fmatrix4 m_model;
+    fvec4 m_tint;
 
-    VertexArrayPtr m_vertex_data;
-    IndexArrayPtr m_index_data;
-    ShaderPtr m_shader;
+    //filled with stencil-then-cover, the last 6 indices are the cover quad
+    bool m_stencil;
+    FillRule m_fill_rule;
 
+    vector<Span> m_spans;
+    fvec4 m_bounds;
     int32_t m_current_index;
     int32_t m_current_vertex;
+    int32_t m_current_instance;
+
+    int32_t m_vertex_base;
+    size_t m_index_offset;
+    size_t m_instance_offset;
 
     //Can't change for batching
+    int32_t m_depth;
     TexturePtr m_texture;
+    array<TextureID, MAX_TEXTURE_SLOTS> m_texture_ids;
+    int32_t m_texture_count;
     bool m_scissor;
     float m_scissor_x;
     float m_scissor_y;
     float m_scissor_width;
     float m_scissor_height;
 public:
-    RenderLayer(Canvas* canvas, uint32_t vertex_buffer, uint32_t index_buffer);
+    RenderLayer(Canvas* canvas, VertexArena* vertex_arena, IndexArena* index_arena, InstanceArena* instance_arena);
     ~RenderLayer();
 
-    bool draw(const vector<VertexData>& vertices, const vector<uint16_t>& indices, bool flipped_y = false);
+    bool draw(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const uint16_t* indices, size_t index_count, const VertexTransform& transform);
+    bool draw(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count, const VertexTransform& transform);
+    bool draw(TexturePtr texture, const SpriteInstance& instance);
+    bool draw(StaticMeshPtr mesh, const fmatrix4& model, const fvec4& tint);
+    //takes over geometry already transformed into the arenas, its indices start at 0
+    bool claim(TexturePtr texture, size_t vertex_start, size_t vertex_count, size_t index_start, size_t index_count);
+    //like claim but for a fresh layer that keeps the fill to itself
+    bool stencil(size_t vertex_start, size_t vertex_count, size_t index_start, size_t index_count, FillRule rule);
     bool validate(TexturePtr texture, ShaderPtr shader);
+    bool overlaps(const fvec4& bounds);
+    void extend(const fvec4& bounds);
     bool texture();
+    bool instanced();
     bool scissor_test();
 
     float get_scissor_x();
@@ -47,11 +85,32 @@ public:
     float get_scissor_width();
     float get_scissor_height();
 
+    int32_t get_vertex_count();
+    int32_t get_index_count();
+    int32_t get_index_size();
+    int32_t get_instance_count();
+    size_t get_instance_offset();
+    int32_t get_free_vertices();
+    int32_t get_free_indices();
+    int32_t get_depth();
+    const fvec4& get_bounds();
+
     TexturePtr get_texture();
     ShaderPtr get_shader();
+    StaticMeshPtr get_mesh();
+    const fmatrix4& get_model();
+    const fvec4& get_tint();
 
-    void reset(TexturePtr texture, ShaderPtr shader);
-    void upload(int32_t va, int32_t ca);
+    void reset(TexturePtr texture, ShaderPtr shader, bool instanced = false);
+    void upload(VertexData* vertices, uint8_t* indices, int32_t vertex_base, size_t index_offset);
+    void upload(SpriteInstance* instances, size_t instance_offset);
+    void render(const ivec4* clip = nullptr);
+private:
+    template<typename T>
+    bool append(TexturePtr texture, const VertexData* vertices, size_t vertex_count, const T* indices, size_t index_count, const VertexTransform& transform);
+    void render_stencil();
+    int32_t find_slot(TexturePtr texture);
+    void add_span(size_t vertex_start, int32_t vertex_count, size_t index_start, int32_t index_count);
 };
 
 #endif
\ No newline at end of file
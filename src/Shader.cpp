@@ -1,96 +1,328 @@
 #include "Shader.h"
 #include "LogSystem.h"
+#include "GLState.h"
 #include "Texture.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 
-Shader::Shader(unsigned int program) : m_program(program)
+Shader::Shader(unsigned int program) : m_program(0), m_texture_slots(1), m_uniforms(), m_dirty(false), m_animated(false), m_hashed(false), m_uniform_hash(0)
 {
-    set_uniform("tex", (TexturePtr)nullptr);
-    set_uniform("projection", fmatrix4());
+    if (program != 0)
+        set_program(program);
 }
 
 Shader::~Shader()
 {
 }
 
-void Shader::set_uniform(string uniform, const fmatrix4& matrix)
+void Shader::set_uniform(const string& uniform, const fmatrix4& matrix)
 {
-    m_matrices[uniform] = matrix;
+    set_uniform(hash_string(uniform), matrix);
 }
 
-void Shader::set_uniform(string uniform, TexturePtr texture)
+void Shader::set_uniform(const string& uniform, TexturePtr texture)
 {
-    m_textures[uniform] = (texture == nullptr) ? 0 : texture->get_id();
+    set_uniform(hash_string(uniform), texture);
 }
 
-void Shader::set_uniform(string uniform, float val)
+void Shader::set_uniform(const string& uniform, float val)
 {
-    m_float1[uniform] = val;
+    set_uniform(hash_string(uniform), val);
 }
 
-void Shader::set_uniform(string uniform, const fvec2& vec)
+void Shader::set_uniform(const string& uniform, const fvec2& vec)
 {
-    m_float2[uniform] = vec;
+    set_uniform(hash_string(uniform), vec);
 }
 
-void Shader::set_uniform(string uniform, const fvec3& vec)
+void Shader::set_uniform(const string& uniform, const fvec3& vec)
 {
-    m_float3[uniform] = vec;
+    set_uniform(hash_string(uniform), vec);
 }
 
-void Shader::set_uniform(string uniform, const fvec4& vec)
+void Shader::set_uniform(const string& uniform, const fvec4& vec)
 {
-    m_float4[uniform] = vec;
+    set_uniform(hash_string(uniform), vec);
 }
 
-void Shader::set_uniform(string uniform, const Color& col)
+void Shader::set_uniform(const string& uniform, const Color& col)
+{
+    set_uniform(hash_string(uniform), col);
+}
+
+void Shader::set_uniform(UniformID uniform, const fmatrix4& matrix)
+{
+    store(uniform, UniformType::Matrix4, glm::value_ptr(matrix), 16);
+}
+
+void Shader::set_uniform(UniformID uniform, TexturePtr texture)
+{
+    auto* target = locate(uniform);
+    if (target == nullptr)
+        return;
+
+    auto id = (texture == nullptr) ? 0 : (int32_t)texture->get_id();
+    if (target->type == UniformType::Int && target->integer == id)
+        return;
+
+    target->type = UniformType::Int;
+    target->integer = id;
+    target->dirty = true;
+    m_dirty = true;
+    m_hashed = false;
+}
+
+void Shader::set_uniform(UniformID uniform, float val)
+{
+    store(uniform, UniformType::Float1, &val, 1);
+}
+
+void Shader::set_uniform(UniformID uniform, const fvec2& vec)
+{
+    store(uniform, UniformType::Float2, &vec.x, 2);
+}
+
+void Shader::set_uniform(UniformID uniform, const fvec3& vec)
+{
+    store(uniform, UniformType::Float3, &vec.x, 3);
+}
+
+void Shader::set_uniform(UniformID uniform, const fvec4& vec)
+{
+    store(uniform, UniformType::Float4, &vec.x, 4);
+}
+
+void Shader::set_uniform(UniformID uniform, const Color& col)
 {
     set_uniform(uniform, fvec4(col.r, col.g, col.b, col.a));
 }
 
 void Shader::apply()
 {
-    glUseProgram(m_program);
-    CHECK_GL_ERROR;
+    if (m_program == 0)
+        return;
 
-    for (auto it = m_matrices.begin(); it != m_matrices.end(); ++it)
-    {
-        glUniformMatrix4fv(glGetUniformLocation(m_program, it->first.c_str()), 1, false, glm::value_ptr(it->second));
-        CHECK_GL_ERROR;
-    }
+    GLState::get()->use_program(m_program);
+
+    if (!m_dirty)
+        return;
 
-    for (auto it = m_textures.begin(); it != m_textures.end(); ++it)
+    for (auto& uniform : m_uniforms)
     {
-        glUniform1i(glGetUniformLocation(m_program, it->first.c_str()), (GLuint)it->second);
+        if (!uniform.dirty)
+            continue;
+
+        switch (uniform.type)
+        {
+            case UniformType::Int:
+                glUniform1i(uniform.location, uniform.integer);
+                break;
+
+            case UniformType::Float1:
+                glUniform1fv(uniform.location, 1, uniform.values);
+                break;
+
+            case UniformType::Float2:
+                glUniform2fv(uniform.location, 1, uniform.values);
+                break;
+
+            case UniformType::Float3:
+                glUniform3fv(uniform.location, 1, uniform.values);
+                break;
+
+            case UniformType::Float4:
+                glUniform4fv(uniform.location, 1, uniform.values);
+                break;
+
+            case UniformType::Matrix4:
+                glUniformMatrix4fv(uniform.location, 1, false, uniform.values);
+                break;
+
+            default:
+                break;
+        }
+
         CHECK_GL_ERROR;
+        uniform.dirty = false;
     }
 
-    for (auto it = m_float1.begin(); it != m_float1.end(); ++it)
+    m_dirty = false;
+}
+
+void Shader::set_program(uint32_t program)
+{
+    //values set while the program was still linking were kept without a location
+    auto deferred = move(m_uniforms);
+
+    m_program = program;
+    m_hashed = false;
+    reflect();
+
+    set_uniform(UNIFORM_ID("tex"), (TexturePtr)nullptr);
+    set_uniform(UNIFORM_ID("projection"), fmatrix4());
+
+    for (auto& value : deferred)
     {
-        glUniform1f(glGetUniformLocation(m_program, it->first.c_str()), it->second);
-        CHECK_GL_ERROR;
+        auto* target = find(value.id);
+        if (target == nullptr || value.type == UniformType::None)
+            continue;
+
+        target->type = value.type;
+        target->integer = value.integer;
+        memcpy(target->values, value.values, sizeof(value.values));
+        target->dirty = true;
+        m_dirty = true;
     }
+}
+
+void Shader::set_texture_slots(int32_t slots)
+{
+    m_texture_slots = slots;
+}
+
+void Shader::set_animated(bool animated)
+{
+    m_animated = animated;
+}
+
+unsigned int Shader::get_program()
+{
+    return m_program;
+}
+
+int32_t Shader::get_texture_slots()
+{
+    return m_texture_slots;
+}
+
+bool Shader::is_animated()
+{
+    return m_animated;
+}
+
+bool Shader::has_uniform(UniformID uniform)
+{
+    return find(uniform) != nullptr;
+}
 
-    for (auto it = m_float2.begin(); it != m_float2.end(); ++it)
+uint64_t Shader::get_uniform_hash()
+{
+    if (m_hashed)
+        return m_uniform_hash;
+
+    auto hash = HASH_OFFSET_BASIS;
+    for (auto& uniform : m_uniforms)
     {
-        glUniform2f(glGetUniformLocation(m_program, it->first.c_str()), it->second.x, it->second.y);
-        CHECK_GL_ERROR;
+        hash = hash_value(uniform.type, hash_value(uniform.id, hash));
+        hash = hash_value(uniform.integer, hash_bytes(uniform.values, sizeof(uniform.values), hash));
     }
 
-    for (auto it = m_float3.begin(); it != m_float3.end(); ++it)
+    m_uniform_hash = hash;
+    m_hashed = true;
+
+    return hash;
+}
+
+bool Shader::ready()
+{
+    return m_program != 0;
+}
+
+void Shader::reflect()
+{
+    m_uniforms.clear();
+
+    int32_t count = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+    CHECK_GL_ERROR;
+
+    char name[256];
+    for (int32_t i = 0; i < count; i++)
     {
-        glUniform3f(glGetUniformLocation(m_program, it->first.c_str()), it->second.x, it->second.y, it->second.z);
+        int32_t length = 0;
+        int32_t size = 0;
+        GLenum type = 0;
+
+        glGetActiveUniform(m_program, (GLuint)i, sizeof(name), &length, &size, &type, name);
         CHECK_GL_ERROR;
-    }
 
-    for (auto it = m_float4.begin(); it != m_float4.end(); ++it)
-    {
-        glUniform4f(glGetUniformLocation(m_program, it->first.c_str()), it->second.x, it->second.y, it->second.z, it->second.w);
+        //block members have no location of their own
+        auto location = glGetUniformLocation(m_program, name);
         CHECK_GL_ERROR;
+        if (location == -1)
+            continue;
+
+        string uniform(name, length);
+        add_uniform(uniform, location);
+
+        //arrays are reported as "name[0]", make the bare name and every element addressable
+        auto bracket = uniform.find('[');
+        if (bracket == string::npos)
+            continue;
+
+        auto base = uniform.substr(0, bracket);
+        add_uniform(base, location);
+
+        for (int32_t element = 1; element < size; element++)
+        {
+            auto element_name = base + "[" + to_string(element) + "]";
+            add_uniform(element_name, glGetUniformLocation(m_program, element_name.c_str()));
+            CHECK_GL_ERROR;
+        }
     }
+
+    sort(m_uniforms.begin(), m_uniforms.end(), [](const Uniform& a, const Uniform& b) { return a.id < b.id; });
 }
 
-unsigned int Shader::get_program()
+void Shader::add_uniform(const string& name, int32_t location)
 {
-    return m_program;
+    if (location == -1)
+        return;
+
+    Uniform uniform = {};
+    uniform.id = hash_string(name);
+    uniform.location = location;
+    uniform.type = UniformType::None;
+
+    m_uniforms.push_back(uniform);
+}
+
+Shader::Uniform* Shader::find(UniformID uniform)
+{
+    auto it = lower_bound(m_uniforms.begin(), m_uniforms.end(), uniform, [](const Uniform& a, UniformID id) { return a.id < id; });
+    if (it == m_uniforms.end() || it->id != uniform)
+        return nullptr;
+
+    return &*it;
+}
+
+Shader::Uniform* Shader::locate(UniformID uniform)
+{
+    auto* target = find(uniform);
+    if (target != nullptr || m_program != 0)
+        return target;
+
+    Uniform deferred = {};
+    deferred.id = uniform;
+    deferred.location = -1;
+    deferred.type = UniformType::None;
+
+    auto it = lower_bound(m_uniforms.begin(), m_uniforms.end(), uniform, [](const Uniform& a, UniformID id) { return a.id < id; });
+    return &*m_uniforms.insert(it, deferred);
+}
+
+void Shader::store(UniformID uniform, UniformType type, const float* values, int32_t count)
+{
+    auto* target = locate(uniform);
+    if (target == nullptr)
+        return;
+
+    if (target->type == type && memcmp(target->values, values, sizeof(float) * count) == 0)
+        return;
+
+    target->type = type;
+    memcpy(target->values, values, sizeof(float) * count);
+    target->dirty = true;
+    m_dirty = true;
+    m_hashed = false;
 }
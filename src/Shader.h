@@ -3,33 +3,84 @@
 
 #include "Config.h"
 #include "Color.h"
+#include "Hash.h"
+
+using UniformID = uint64_t;
+#define UNIFORM_ID(NAME) integral_constant<UniformID, hash_string(NAME)>::value
 
 class Shader
 {
 private:
+    enum class UniformType
+    {
+        None,
+        Int,
+        Float1,
+        Float2,
+        Float3,
+        Float4,
+        Matrix4
+    };
+
+    //resolved once after link, values are only uploaded when they changed
+    struct Uniform
+    {
+        UniformID id;
+        int32_t location;
+        UniformType type;
+        bool dirty;
+        float values[16];
+        int32_t integer;
+    };
+
     uint32_t m_program;
+    int32_t m_texture_slots;
 
-    unordered_map<string, fmatrix4> m_matrices;
-    unordered_map<string, TextureID> m_textures;
-    unordered_map<string, float> m_float1;
-    unordered_map<string, fvec2> m_float2;
-    unordered_map<string, fvec3> m_float3;
-    unordered_map<string, fvec4> m_float4;
+    vector<Uniform> m_uniforms;
+    bool m_dirty;
+    bool m_animated;
+    bool m_hashed;
+    uint64_t m_uniform_hash;
 public:
+    //a program of 0 makes a pending shader, values set on it are kept until set_program
     Shader(uint32_t program);
     ~Shader();
 
-    void set_uniform(string uniform, const fmatrix4& matrix);
-    void set_uniform(string uniform, TexturePtr texture);
-    void set_uniform(string uniform, float val);
-    void set_uniform(string uniform, const fvec2& vec);
-    void set_uniform(string uniform, const fvec3& vec);
-    void set_uniform(string uniform, const fvec4& vec);
-    void set_uniform(string uniform, const Color& col);
+    void set_uniform(const string& uniform, const fmatrix4& matrix);
+    void set_uniform(const string& uniform, TexturePtr texture);
+    void set_uniform(const string& uniform, float val);
+    void set_uniform(const string& uniform, const fvec2& vec);
+    void set_uniform(const string& uniform, const fvec3& vec);
+    void set_uniform(const string& uniform, const fvec4& vec);
+    void set_uniform(const string& uniform, const Color& col);
+
+    void set_uniform(UniformID uniform, const fmatrix4& matrix);
+    void set_uniform(UniformID uniform, TexturePtr texture);
+    void set_uniform(UniformID uniform, float val);
+    void set_uniform(UniformID uniform, const fvec2& vec);
+    void set_uniform(UniformID uniform, const fvec3& vec);
+    void set_uniform(UniformID uniform, const fvec4& vec);
+    void set_uniform(UniformID uniform, const Color& col);
 
     void apply();
+    void set_program(uint32_t program);
+    void set_texture_slots(int32_t slots);
+    //set for programs that read time or delta_time, their draws change every frame
+    void set_animated(bool animated);
 
     uint32_t get_program();
+    int32_t get_texture_slots();
+    bool is_animated();
+    bool has_uniform(UniformID uniform);
+    //covers every value set so far, whether uploaded yet or not
+    uint64_t get_uniform_hash();
+    bool ready();
+private:
+    void reflect();
+    void add_uniform(const string& name, int32_t location);
+    Uniform* find(UniformID uniform);
+    Uniform* locate(UniformID uniform);
+    void store(UniformID uniform, UniformType type, const float* values, int32_t count);
 };
 
 #endif
@@ -0,0 +1,363 @@
+#include "ShapeCache.h"
+#include "Hash.h"
+#include "Feather.h"
+
+#include <algorithm>
+#include <cfloat>
+
+static const float PI = 3.14159265358979f;
+
+const int32_t ShapeCache::MIN_SEGMENTS;
+const int32_t ShapeCache::MAX_SEGMENTS;
+
+static inline int32_t snap_length(float value)
+{
+    return (int32_t)roundf(value * 16.0f);
+}
+
+static inline int32_t snap_angle(float value)
+{
+    return (int32_t)roundf(value / (2.0f * PI) * 4096.0f);
+}
+
+//fringe widths in 1/8th octaves, close enough to a pixel to share meshes between nearby scales
+static inline int32_t snap_feather(float width)
+{
+    return width > 0.0f ? (int32_t)roundf(log2f(width) * 8.0f) : INT32_MIN;
+}
+
+static inline float get_feather(int32_t snapped)
+{
+    return snapped == INT32_MIN ? 0.0f : exp2f(snapped / 8.0f);
+}
+
+static size_t get_size(const ShapeMesh& mesh)
+{
+    return sizeof(ShapeMesh) + sizeof(VertexData) * mesh.vertices.capacity() + sizeof(uint32_t) * mesh.indices.capacity();
+}
+
+//feathered when a width is given, the ring's points start at the returned index either way
+static uint32_t add_ring(ShapeMesh& mesh, const vector<fvec2>& ring, float feather, float orientation)
+{
+    if (feather > 0.0f)
+        return feather_ring(ring.data(), ring.size(), feather, orientation, mesh.vertices, mesh.indices);
+
+    auto base = (uint32_t)mesh.vertices.size();
+    for (auto& point : ring)
+        mesh.vertices.emplace_back(point);
+
+    return base;
+}
+
+//uvs span the shape's nominal rect, the fringe reaches slightly past it
+static void finish(ShapeMesh& mesh, const fvec4& rect)
+{
+    mesh.bounds = fvec4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (auto& vertex : mesh.vertices)
+    {
+        vertex.uv.x = rect.z > rect.x ? (vertex.v.x - rect.x) / (rect.z - rect.x) : 0.0f;
+        vertex.uv.y = rect.w > rect.y ? (vertex.v.y - rect.y) / (rect.w - rect.y) : 0.0f;
+
+        mesh.bounds.x = min(mesh.bounds.x, vertex.v.x);
+        mesh.bounds.y = min(mesh.bounds.y, vertex.v.y);
+        mesh.bounds.z = max(mesh.bounds.z, vertex.v.x);
+        mesh.bounds.w = max(mesh.bounds.w, vertex.v.y);
+    }
+
+    mesh.vertices.shrink_to_fit();
+    mesh.indices.shrink_to_fit();
+}
+
+ShapeCache::ShapeCache(size_t budget) :
+    m_entries(), m_lookup(), m_budget(budget), m_bytes(0), m_hits(0), m_misses(0), m_evictions(0)
+{
+}
+
+ShapeCache::~ShapeCache()
+{
+}
+
+int32_t ShapeCache::get_segments(float radius, float tolerance)
+{
+    if (radius <= tolerance)
+        return MIN_SEGMENTS;
+
+    auto step = 2.0f * acosf(1.0f - tolerance / radius);
+    auto segments = ((int32_t)ceilf(2.0f * PI / step) + 7) & ~7;
+
+    return max(MIN_SEGMENTS, min(MAX_SEGMENTS, segments));
+}
+
+const ShapeMesh& ShapeCache::circle(int32_t segments, float feather)
+{
+    auto snapped = snap_feather(feather);
+    auto key = hash_value(snapped, hash_value(segments, hash_value(Kind::Circle)));
+    if (auto* mesh = find(key))
+        return *mesh;
+
+    feather = get_feather(snapped);
+
+    vector<fvec2> ring;
+    ring.reserve(segments);
+    for (int32_t i = 0; i < segments; i++)
+    {
+        auto angle = 2.0f * PI * i / segments;
+        ring.emplace_back(cosf(angle), sinf(angle));
+    }
+
+    ShapeMesh mesh;
+    auto base = add_ring(mesh, ring, feather, 1.0f);
+    auto center = (uint32_t)mesh.vertices.size();
+    mesh.vertices.emplace_back(fvec2(0.0f, 0.0f));
+
+    for (uint32_t i = 0; i < (uint32_t)segments; i++)
+    {
+        mesh.indices.push_back(center);
+        mesh.indices.push_back(base + i);
+        mesh.indices.push_back(base + (i + 1) % segments);
+    }
+
+    finish(mesh, fvec4(-1.0f, -1.0f, 1.0f, 1.0f));
+    return insert(key, move(mesh));
+}
+
+const ShapeMesh& ShapeCache::arc(float start, float end, float inner, int32_t segments, float feather)
+{
+    auto first = snap_angle(start);
+    auto sweep = max(-4096, min(4096, snap_angle(end) - first));
+    auto ratio = max(0, min(4096, (int32_t)roundf(inner * 4096.0f)));
+
+    if (abs(sweep) == 4096 && ratio == 0)
+        return circle(segments, feather);
+
+    //a sweep only gets its share of the full circle's segments
+    segments = max(1, min(MAX_SEGMENTS, (int32_t)ceilf(segments * abs(sweep) / 4096.0f)));
+
+    auto snapped = snap_feather(feather);
+    auto key = hash_value(snapped, hash_value(segments, hash_value(ratio, hash_value(sweep, hash_value(first, hash_value(Kind::Arc))))));
+    if (auto* mesh = find(key))
+        return *mesh;
+
+    feather = get_feather(snapped);
+    start = first * 2.0f * PI / 4096.0f;
+    auto span = sweep * 2.0f * PI / 4096.0f;
+    inner = ratio / 4096.0f;
+
+    vector<fvec2> outer;
+    for (int32_t i = 0; i <= segments; i++)
+    {
+        auto angle = start + span * i / segments;
+        outer.emplace_back(cosf(angle), sinf(angle));
+    }
+
+    ShapeMesh mesh;
+    auto n = (uint32_t)segments;
+
+    if (abs(sweep) == 4096)
+    {
+        //closed band, two rings with the solid between them
+        outer.pop_back();
+        vector<fvec2> hole(outer.rbegin(), outer.rend());
+        for (auto& point : hole)
+            point = point * inner;
+
+        auto orientation = sweep > 0 ? 1.0f : -1.0f;
+        auto outer_base = add_ring(mesh, outer, feather, orientation);
+        auto inner_base = add_ring(mesh, hole, feather, orientation);
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            auto j = (i + 1) % n;
+            uint32_t quad[6] = { outer_base + i, outer_base + j, inner_base + (n - 1 - j), outer_base + i, inner_base + (n - 1 - j), inner_base + (n - 1 - i) };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    else
+    {
+        //one outline, out along the outer edge and back along the inner one or through the center
+        vector<fvec2> ring(outer);
+        if (ratio == 0)
+            ring.emplace_back(0.0f, 0.0f);
+        else
+            for (auto it = outer.rbegin(); it != outer.rend(); ++it)
+                ring.push_back(*it * inner);
+
+        auto base = add_ring(mesh, ring, feather, ring_orientation(ring.data(), ring.size()));
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (ratio == 0)
+            {
+                uint32_t triangle[3] = { base + n + 1, base + i, base + i + 1 };
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+                continue;
+            }
+
+            //inner point k mirrors outer point 2n + 1 - k
+            auto last = 2 * n + 1;
+            uint32_t quad[6] = { base + i, base + i + 1, base + last - (i + 1), base + i, base + last - (i + 1), base + last - i };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+
+    finish(mesh, fvec4(-1.0f, -1.0f, 1.0f, 1.0f));
+    return insert(key, move(mesh));
+}
+
+const ShapeMesh& ShapeCache::rounded_rect(float w, float h, float radius, int32_t segments, float feather)
+{
+    auto sw = snap_length(w);
+    auto sh = snap_length(h);
+    auto sr = min(snap_length(radius), min(sw, sh) / 2);
+    auto corner_segments = sr == 0 ? 1 : max(1, segments / 4);
+    auto snapped = snap_feather(feather);
+
+    auto key = hash_value(snapped, hash_value(corner_segments, hash_value(sr, hash_value(sh, hash_value(sw, hash_value(Kind::RoundedRect))))));
+    if (auto* mesh = find(key))
+        return *mesh;
+
+    w = sw / 16.0f;
+    h = sh / 16.0f;
+    radius = sr / 16.0f;
+    feather = get_feather(snapped);
+
+    //corners clockwise on screen from the top left
+    fvec2 centers[4] = {
+        fvec2(radius, radius), fvec2(w - radius, radius),
+        fvec2(w - radius, h - radius), fvec2(radius, h - radius)
+    };
+
+    vector<fvec2> ring;
+    ring.reserve(4 * (corner_segments + 1));
+    for (int32_t corner = 0; corner < 4; corner++)
+    {
+        for (int32_t i = 0; i <= corner_segments; i++)
+        {
+            auto angle = PI * (1.0f + corner * 0.5f + 0.5f * i / corner_segments);
+            ring.push_back(centers[corner] + fvec2(cosf(angle), sinf(angle)) * radius);
+        }
+    }
+
+    //y down, so clockwise on screen is counter clockwise with y up
+    ShapeMesh mesh;
+    auto base = add_ring(mesh, ring, feather, 1.0f);
+    auto center = (uint32_t)mesh.vertices.size();
+    mesh.vertices.emplace_back(fvec2(w * 0.5f, h * 0.5f));
+
+    auto outline = (uint32_t)ring.size();
+    for (uint32_t i = 0; i < outline; i++)
+    {
+        mesh.indices.push_back(center);
+        mesh.indices.push_back(base + i);
+        mesh.indices.push_back(base + (i + 1) % outline);
+    }
+
+    finish(mesh, fvec4(0.0f, 0.0f, w, h));
+    return insert(key, move(mesh));
+}
+
+const ShapeMesh& ShapeCache::nine_slice(float w, float h, const fvec4& insets, const fvec4& uv_insets)
+{
+    auto key = hash_value(Kind::NineSlice);
+    key = hash_value(snap_length(w), hash_value(snap_length(h), key));
+    key = hash_value(ivec4(snap_length(insets.x), snap_length(insets.y), snap_length(insets.z), snap_length(insets.w)), key);
+    key = hash_value(uv_insets, key);
+    if (auto* mesh = find(key))
+        return *mesh;
+
+    w = snap_length(w) / 16.0f;
+    h = snap_length(h) / 16.0f;
+
+    float xs[4] = { 0.0f, insets.x, w - insets.z, w };
+    float ys[4] = { 0.0f, insets.y, h - insets.w, h };
+    float us[4] = { 0.0f, uv_insets.x, 1.0f - uv_insets.z, 1.0f };
+    float vs[4] = { 0.0f, uv_insets.y, 1.0f - uv_insets.w, 1.0f };
+
+    ShapeMesh mesh;
+    mesh.vertices.reserve(16);
+    mesh.indices.reserve(54);
+
+    for (int32_t y = 0; y < 4; y++)
+    {
+        for (int32_t x = 0; x < 4; x++)
+            mesh.vertices.emplace_back(fvec2(xs[x], ys[y]), fvec2(us[x], vs[y]));
+    }
+
+    for (int32_t y = 0; y < 3; y++)
+    {
+        for (int32_t x = 0; x < 3; x++)
+        {
+            auto base = (uint32_t)(y * 4 + x);
+            uint32_t quad[6] = { base, base + 1, base + 5, base, base + 5, base + 4 };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+
+    mesh.bounds = fvec4(0.0f, 0.0f, w, h);
+    return insert(key, move(mesh));
+}
+
+void ShapeCache::set_budget(size_t bytes)
+{
+    m_budget = bytes;
+    trim();
+}
+
+void ShapeCache::clear()
+{
+    m_entries.clear();
+    m_lookup.clear();
+    m_bytes = 0;
+}
+
+ShapeCacheStats ShapeCache::get_stats()
+{
+    ShapeCacheStats stats = {};
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    stats.entries = (int32_t)m_entries.size();
+    stats.bytes = m_bytes;
+    stats.budget = m_budget;
+    stats.hit_rate = m_hits + m_misses > 0 ? (float)m_hits / (m_hits + m_misses) : 0.0f;
+
+    return stats;
+}
+
+const ShapeMesh* ShapeCache::find(uint64_t key)
+{
+    auto it = m_lookup.find(key);
+    if (it == m_lookup.end())
+    {
+        m_misses++;
+        return nullptr;
+    }
+
+    //most recently used at the front
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    m_hits++;
+
+    return &it->second->mesh;
+}
+
+const ShapeMesh& ShapeCache::insert(uint64_t key, ShapeMesh&& mesh)
+{
+    m_entries.push_front({ key, move(mesh) });
+    m_lookup[key] = m_entries.begin();
+    m_bytes += get_size(m_entries.front().mesh);
+
+    trim();
+    return m_entries.front().mesh;
+}
+
+void ShapeCache::trim()
+{
+    //the front entry stays even over budget, the caller is about to draw it
+    while (m_bytes > m_budget && m_entries.size() > 1)
+    {
+        auto& last = m_entries.back();
+        m_bytes -= get_size(last.mesh);
+        m_lookup.erase(last.key);
+        m_entries.pop_back();
+        m_evictions++;
+    }
+}
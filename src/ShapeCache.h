@@ -0,0 +1,85 @@
+#ifndef _SHAPE_CACHE_H_
+#define _SHAPE_CACHE_H_
+
+#include "Config.h"
+#include "Canvas.h"
+
+#include <list>
+
+struct ShapeCacheStats
+{
+    int64_t hits;
+    int64_t misses;
+    int64_t evictions;
+    int32_t entries;
+    size_t bytes;
+    size_t budget;
+    float hit_rate;
+};
+
+struct ShapeMesh
+{
+    vector<VertexData> vertices;
+    vector<uint32_t> indices;
+    fvec4 bounds;
+};
+
+//Meshes for the canvas' built-in primitives, kept until the memory budget runs
+//out in least recently used order. Circles and arcs are built around the origin
+//with a radius of 1 and placed by the draw's matrix, the rest in local pixels.
+//Lengths are snapped to 1/16th of a pixel and angles to 1/4096th of a turn.
+//Feather is the width of the antialiased fringe in the mesh's units, 0 for none
+class ShapeCache
+{
+public:
+    static const size_t DEFAULT_BUDGET = 4 << 20;
+    static const int32_t MIN_SEGMENTS = 8;
+    static const int32_t MAX_SEGMENTS = 512;
+private:
+    enum class Kind : uint32_t
+    {
+        Circle,
+        Arc,
+        RoundedRect,
+        NineSlice
+    };
+
+    struct Entry
+    {
+        uint64_t key;
+        ShapeMesh mesh;
+    };
+
+    list<Entry> m_entries;
+    unordered_map<uint64_t, list<Entry>::iterator> m_lookup;
+    size_t m_budget;
+    size_t m_bytes;
+    int64_t m_hits;
+    int64_t m_misses;
+    int64_t m_evictions;
+public:
+    ShapeCache(size_t budget = DEFAULT_BUDGET);
+    ~ShapeCache();
+
+    //segments a full circle of this radius in device pixels needs to stay within tolerance, rounded up to a multiple of 8
+    static int32_t get_segments(float radius, float tolerance);
+
+    const ShapeMesh& circle(int32_t segments, float feather = 0.0f);
+    //ring between inner and 1 from start to end, angles in radians
+    const ShapeMesh& arc(float start, float end, float inner, int32_t segments, float feather = 0.0f);
+    //segments for the whole outline, a quarter of them per corner
+    const ShapeMesh& rounded_rect(float w, float h, float radius, int32_t segments, float feather = 0.0f);
+    //insets are the border widths left, top, right, bottom in local pixels and uv space
+    const ShapeMesh& nine_slice(float w, float h, const fvec4& insets, const fvec4& uv_insets);
+
+    void set_budget(size_t bytes);
+    void clear();
+
+    ShapeCacheStats get_stats();
+private:
+    const ShapeMesh* find(uint64_t key);
+    const ShapeMesh& insert(uint64_t key, ShapeMesh&& mesh);
+    void trim();
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "SkylinePacker.h"
+
+SkylinePacker::SkylinePacker(int32_t width, int32_t height) :
+    m_width(width), m_height(height), m_used_area(0), m_skyline()
+{
+    reset();
+}
+
+SkylinePacker::~SkylinePacker()
+{
+}
+
+bool SkylinePacker::pack(int32_t width, int32_t height, ivec2& position)
+{
+    int32_t best_y = m_height;
+    int32_t best_width = m_width + 1;
+    int32_t best_index = -1;
+
+    for (size_t i = 0; i < m_skyline.size(); i++)
+    {
+        int32_t y = fit(i, width, height);
+        if (y < 0)
+            continue;
+
+        if (y < best_y || (y == best_y && m_skyline[i].width < best_width))
+        {
+            best_y = y;
+            best_width = m_skyline[i].width;
+            best_index = (int32_t)i;
+        }
+    }
+
+    if (best_index == -1)
+        return false;
+
+    position.x = m_skyline[best_index].x;
+    position.y = best_y;
+
+    Segment segment = { position.x, best_y + height, width };
+    m_skyline.insert(m_skyline.begin() + best_index, segment);
+
+    //shrink or drop the segments now covered by the new one
+    for (size_t i = best_index + 1; i < m_skyline.size(); i++)
+    {
+        auto& previous = m_skyline[i - 1];
+        auto& current = m_skyline[i];
+
+        if (current.x >= previous.x + previous.width)
+            break;
+
+        int32_t shrink = previous.x + previous.width - current.x;
+        current.x += shrink;
+        current.width -= shrink;
+
+        if (current.width > 0)
+            break;
+
+        m_skyline.erase(m_skyline.begin() + i);
+        i--;
+    }
+
+    merge();
+
+    m_used_area += (int64_t)width * height;
+    return true;
+}
+
+void SkylinePacker::reset()
+{
+    m_skyline.clear();
+    m_skyline.push_back({ 0, 0, m_width });
+    m_used_area = 0;
+}
+
+int32_t SkylinePacker::get_width()
+{
+    return m_width;
+}
+
+int32_t SkylinePacker::get_height()
+{
+    return m_height;
+}
+
+int64_t SkylinePacker::get_used_area()
+{
+    return m_used_area;
+}
+
+int32_t SkylinePacker::fit(size_t index, int32_t width, int32_t height)
+{
+    int32_t x = m_skyline[index].x;
+    if (x + width > m_width)
+        return -1;
+
+    int32_t y = m_skyline[index].y;
+    int32_t remaining = width;
+
+    while (remaining > 0)
+    {
+        if (index >= m_skyline.size())
+            return -1;
+
+        y = max(y, m_skyline[index].y);
+        if (y + height > m_height)
+            return -1;
+
+        remaining -= m_skyline[index].width;
+        index++;
+    }
+
+    return y;
+}
+
+void SkylinePacker::merge()
+{
+    size_t i = 0;
+    while (i + 1 < m_skyline.size())
+    {
+        if (m_skyline[i].y != m_skyline[i + 1].y)
+        {
+            i++;
+            continue;
+        }
+
+        m_skyline[i].width += m_skyline[i + 1].width;
+        m_skyline.erase(m_skyline.begin() + i + 1);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef _SKYLINE_PACKER_H_
+#define _SKYLINE_PACKER_H_
+
+#include "Config.h"
+
+//Bottom-left skyline rectangle packer
+class SkylinePacker
+{
+private:
+    struct Segment
+    {
+        int32_t x;
+        int32_t y;
+        int32_t width;
+    };
+
+    int32_t m_width;
+    int32_t m_height;
+    int64_t m_used_area;
+    vector<Segment> m_skyline;
+public:
+    SkylinePacker(int32_t width, int32_t height);
+    ~SkylinePacker();
+
+    bool pack(int32_t width, int32_t height, ivec2& position);
+    void reset();
+
+    int32_t get_width();
+    int32_t get_height();
+    int64_t get_used_area();
+private:
+    int32_t fit(size_t index, int32_t width, int32_t height);
+    void merge();
+};
+
+#endif
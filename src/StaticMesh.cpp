@@ -0,0 +1,189 @@
+#include "StaticMesh.h"
+#include "GLState.h"
+
+#include <cfloat>
+
+StaticMesh::StaticMesh(TexturePtr texture) :
+    m_texture(texture), m_vertices(), m_indices(), m_bounds(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX),
+    m_vao(0), m_buffers(), m_vertex_count(0), m_index_count(0), m_index_size(sizeof(uint16_t)), m_version(0), m_dirty(false), m_released(false)
+{
+}
+
+StaticMesh::~StaticMesh()
+{
+    if (m_vao == 0)
+        return;
+
+    GLState::get()->delete_buffer(m_buffers[0]);
+    GLState::get()->delete_buffer(m_buffers[1]);
+    GLState::get()->delete_vertex_array(m_vao);
+}
+
+void StaticMesh::add(const vector<VertexData>& vertices, const vector<uint16_t>& indices)
+{
+    append(vertices, indices);
+}
+
+void StaticMesh::add(const vector<VertexData>& vertices, const vector<uint32_t>& indices)
+{
+    append(vertices, indices);
+}
+
+void StaticMesh::clear()
+{
+    m_vertices.clear();
+    m_indices.clear();
+    m_bounds = fvec4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    m_version++;
+    m_dirty = true;
+    m_released = false;
+}
+
+void StaticMesh::upload()
+{
+    if (!m_dirty)
+        return;
+
+    if (m_vao == 0)
+    {
+        glGenVertexArrays(1, &m_vao);
+        CHECK_GL_ERROR;
+        glGenBuffers(2, m_buffers);
+        CHECK_GL_ERROR;
+    }
+
+    GLState::get()->bind_vertex_array(m_vao);
+    GLState::get()->bind_buffer(GL_ARRAY_BUFFER, m_buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexData) * m_vertices.size(), m_vertices.data(), GL_STATIC_DRAW);
+    CHECK_GL_ERROR;
+
+    m_index_size = m_vertices.size() > 0xFFFF ? sizeof(uint32_t) : sizeof(uint16_t);
+    m_vertex_count = (int32_t)m_vertices.size();
+    m_index_count = (int32_t)m_indices.size();
+
+    GLState::get()->bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[1]);
+
+    if (m_index_size == sizeof(uint32_t))
+    {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_indices.size(), m_indices.data(), GL_STATIC_DRAW);
+        CHECK_GL_ERROR;
+    }
+    else
+    {
+        vector<uint16_t> indices(m_indices.begin(), m_indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+        CHECK_GL_ERROR;
+    }
+
+    //same locations create_shader binds position, color and slot to
+#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, v));
+    CHECK_GL_ERROR;
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, color));
+    CHECK_GL_ERROR;
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(VertexData), (GLvoid*)OFFSETOF(VertexData, slot));
+    CHECK_GL_ERROR;
+#undef OFFSETOF
+
+    glEnableVertexAttribArray(0);
+    CHECK_GL_ERROR;
+    glEnableVertexAttribArray(1);
+    CHECK_GL_ERROR;
+    glEnableVertexAttribArray(3);
+    CHECK_GL_ERROR;
+
+    vector<VertexData>().swap(m_vertices);
+    vector<uint32_t>().swap(m_indices);
+    m_released = true;
+    m_dirty = false;
+}
+
+void StaticMesh::render()
+{
+    if (m_vao == 0 || m_index_count == 0)
+        return;
+
+    GLState::get()->bind_vertex_array(m_vao);
+    glDrawElements(GL_TRIANGLES, m_index_count, m_index_size == sizeof(uint32_t) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT, 0);
+    CHECK_GL_ERROR;
+}
+
+TexturePtr StaticMesh::get_texture()
+{
+    return m_texture;
+}
+
+const fvec4& StaticMesh::get_bounds()
+{
+    return m_bounds;
+}
+
+int32_t StaticMesh::get_vertex_count()
+{
+    return m_released ? m_vertex_count : (int32_t)m_vertices.size();
+}
+
+int32_t StaticMesh::get_index_count()
+{
+    return m_released ? m_index_count : (int32_t)m_indices.size();
+}
+
+uint32_t StaticMesh::get_version()
+{
+    return m_version;
+}
+
+void StaticMesh::restore()
+{
+    m_vertices.resize(m_vertex_count);
+    m_indices.resize(m_index_count);
+
+    //the element buffer binding belongs to the vao
+    GLState::get()->bind_vertex_array(m_vao);
+    GLState::get()->bind_buffer(GL_ARRAY_BUFFER, m_buffers[0]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(VertexData) * m_vertices.size(), m_vertices.data());
+    CHECK_GL_ERROR;
+
+    GLState::get()->bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[1]);
+
+    if (m_index_size == sizeof(uint32_t))
+    {
+        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint32_t) * m_indices.size(), m_indices.data());
+        CHECK_GL_ERROR;
+    }
+    else
+    {
+        vector<uint16_t> indices(m_indices.size());
+        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint16_t) * indices.size(), indices.data());
+        CHECK_GL_ERROR;
+        m_indices.assign(indices.begin(), indices.end());
+    }
+
+    m_released = false;
+}
+
+template<typename T>
+void StaticMesh::append(const vector<VertexData>& vertices, const vector<T>& indices)
+{
+    if (m_released)
+        restore();
+
+    auto base = (uint32_t)m_vertices.size();
+
+    for (auto& vertex : vertices)
+    {
+        m_vertices.push_back(vertex);
+        m_vertices.back().slot = 0;
+
+        m_bounds.x = min(m_bounds.x, vertex.v.x);
+        m_bounds.y = min(m_bounds.y, vertex.v.y);
+        m_bounds.z = max(m_bounds.z, vertex.v.x);
+        m_bounds.w = max(m_bounds.w, vertex.v.y);
+    }
+
+    for (auto index : indices)
+        m_indices.push_back(base + index);
+
+    m_version++;
+    m_dirty = true;
+}
@@ -0,0 +1,48 @@
+#ifndef _STATIC_MESH_H_
+#define _STATIC_MESH_H_
+
+#include "Config.h"
+#include "Canvas.h"
+
+//Geometry uploaded once into its own buffers and redrawn with only a model
+//matrix and tint, uvs stay in texture space so atlas repacks don't invalidate it.
+//Only the gpu keeps the geometry once uploaded, adding to it later reads it back first
+class StaticMesh
+{
+private:
+    TexturePtr m_texture;
+    vector<VertexData> m_vertices;
+    vector<uint32_t> m_indices;
+    fvec4 m_bounds;
+
+    uint32_t m_vao;
+    uint32_t m_buffers[2];
+    int32_t m_vertex_count;
+    int32_t m_index_count;
+    int32_t m_index_size;
+    uint32_t m_version;
+    bool m_dirty;
+    bool m_released;
+public:
+    StaticMesh(TexturePtr texture);
+    ~StaticMesh();
+
+    void add(const vector<VertexData>& vertices, const vector<uint16_t>& indices);
+    void add(const vector<VertexData>& vertices, const vector<uint32_t>& indices);
+    void clear();
+
+    void upload();
+    void render();
+
+    TexturePtr get_texture();
+    const fvec4& get_bounds();
+    int32_t get_vertex_count();
+    int32_t get_index_count();
+    uint32_t get_version();
+private:
+    void restore();
+    template<typename T>
+    void append(const vector<VertexData>& vertices, const vector<T>& indices);
+};
+
+#endif
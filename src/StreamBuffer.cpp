@@ -0,0 +1,171 @@
+#include "StreamBuffer.h"
+#include "LogSystem.h"
+#include "GLState.h"
+
+static const GLbitfield STORAGE_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+//the context is 3.3 core, glBufferStorage only exists on drivers that advertise the extension
+using BufferStorageProc = void (APIENTRY*)(GLenum, GLsizeiptr, const void*, GLbitfield);
+static BufferStorageProc buffer_storage = nullptr;
+
+static bool buffer_storage_supported()
+{
+    static int32_t supported = -1;
+    if (supported == -1)
+    {
+        if (SDL_GL_ExtensionSupported("GL_ARB_buffer_storage"))
+            buffer_storage = (BufferStorageProc)SDL_GL_GetProcAddress("glBufferStorage");
+
+        supported = buffer_storage != nullptr ? 1 : 0;
+    }
+
+    return supported == 1;
+}
+
+StreamBuffer::StreamBuffer(uint32_t target, size_t alignment, size_t region_size) :
+    m_target(target), m_buffer(0), m_alignment(alignment), m_region_size(0), m_size(0), m_region(0), m_generation(0),
+    m_persistent(buffer_storage_supported()), m_mapped(nullptr), m_shadow(), m_fences()
+{
+    allocate(region_size);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    release();
+}
+
+uint8_t* StreamBuffer::map(size_t size)
+{
+    size = ((size + m_alignment - 1) / m_alignment) * m_alignment;
+
+    if (size > m_region_size)
+    {
+        release();
+        allocate(max(size, m_region_size * 2));
+    }
+
+    m_size = size;
+
+    if (!m_persistent)
+    {
+        if (m_shadow.size() < size)
+            m_shadow.resize(size);
+
+        return m_shadow.data();
+    }
+
+    wait(m_region);
+    return m_mapped + get_offset();
+}
+
+void StreamBuffer::unmap()
+{
+    if (m_persistent || m_size == 0)
+        return;
+
+    GLState::get()->bind_buffer(m_target, m_buffer);
+    glBufferData(m_target, m_size, m_shadow.data(), GL_STREAM_DRAW);
+    CHECK_GL_ERROR;
+}
+
+void StreamBuffer::fence()
+{
+    if (!m_persistent)
+        return;
+
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    CHECK_GL_ERROR;
+
+    m_region = (m_region + 1) % NUM_REGIONS;
+}
+
+bool StreamBuffer::persistent()
+{
+    return m_persistent;
+}
+
+uint32_t StreamBuffer::get_buffer()
+{
+    return m_buffer;
+}
+
+size_t StreamBuffer::get_offset()
+{
+    return m_persistent ? m_region * m_region_size : 0;
+}
+
+uint32_t StreamBuffer::get_generation()
+{
+    return m_generation;
+}
+
+void StreamBuffer::allocate(size_t region_size)
+{
+    m_region_size = ((region_size + m_alignment - 1) / m_alignment) * m_alignment;
+    m_region = 0;
+    m_generation++;
+
+    glGenBuffers(1, &m_buffer);
+    CHECK_GL_ERROR;
+
+    if (!m_persistent)
+        return;
+
+    GLState::get()->bind_buffer(m_target, m_buffer);
+    buffer_storage(m_target, m_region_size * NUM_REGIONS, nullptr, STORAGE_FLAGS);
+    CHECK_GL_ERROR;
+
+    m_mapped = (uint8_t*)glMapBufferRange(m_target, 0, m_region_size * NUM_REGIONS, STORAGE_FLAGS);
+    CHECK_GL_ERROR;
+
+    if (m_mapped == nullptr)
+    {
+        LogSystem::get()->warn("Failed to persistently map stream buffer, falling back to glBufferData");
+
+        GLState::get()->delete_buffer(m_buffer);
+        glGenBuffers(1, &m_buffer);
+        CHECK_GL_ERROR;
+
+        m_persistent = false;
+    }
+}
+
+void StreamBuffer::release()
+{
+    for (int32_t i = 0; i < NUM_REGIONS; i++)
+    {
+        if (m_fences[i] == nullptr)
+            continue;
+
+        glDeleteSync(m_fences[i]);
+        CHECK_GL_ERROR;
+        m_fences[i] = nullptr;
+    }
+
+    if (m_mapped != nullptr)
+    {
+        GLState::get()->bind_buffer(m_target, m_buffer);
+        glUnmapBuffer(m_target);
+        CHECK_GL_ERROR;
+        m_mapped = nullptr;
+    }
+
+    //the driver keeps the storage alive until pending draws that read from it have finished
+    GLState::get()->delete_buffer(m_buffer);
+    m_buffer = 0;
+}
+
+void StreamBuffer::wait(int32_t region)
+{
+    auto fence = m_fences[region];
+    if (fence == nullptr)
+        return;
+
+    auto result = glClientWaitSync(fence, 0, 0);
+    while (result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+    glDeleteSync(fence);
+    CHECK_GL_ERROR;
+    m_fences[region] = nullptr;
+}
@@ -0,0 +1,45 @@
+#ifndef _STREAM_BUFFER_H_
+#define _STREAM_BUFFER_H_
+
+#include "Config.h"
+
+//Frame-level streaming buffer split into NUM_REGIONS regions. When
+//GL_ARB_buffer_storage is advertised the buffer is persistently mapped and
+//every region is guarded by a fence, otherwise the data is staged on the
+//CPU and uploaded with glBufferData once per frame.
+class StreamBuffer
+{
+private:
+    static const int32_t NUM_REGIONS = 3;
+
+    uint32_t m_target;
+    uint32_t m_buffer;
+    size_t m_alignment;
+    size_t m_region_size;
+    size_t m_size;
+    int32_t m_region;
+    uint32_t m_generation;
+
+    bool m_persistent;
+    uint8_t* m_mapped;
+    vector<uint8_t> m_shadow;
+    array<GLsync, NUM_REGIONS> m_fences;
+public:
+    StreamBuffer(uint32_t target, size_t alignment, size_t region_size);
+    ~StreamBuffer();
+
+    uint8_t* map(size_t size);
+    void unmap();
+    void fence();
+
+    bool persistent();
+    uint32_t get_buffer();
+    size_t get_offset();
+    uint32_t get_generation();
+private:
+    void allocate(size_t region_size);
+    void release();
+    void wait(int32_t region);
+};
+
+#endif
@@ -1,7 +1,12 @@
 #include "Texture.h"
 
 Texture::Texture(TextureID id, float width, float height) :
-    m_id(id), m_width(width), m_height(height)
+    m_id(id), m_width(width), m_height(height), m_region(0.0f, 0.0f, 1.0f, 1.0f)
+{
+}
+
+Texture::Texture(TextureID id, float width, float height, const fvec4& region) :
+    m_id(id), m_width(width), m_height(height), m_region(region)
 {
 }
 
@@ -23,3 +28,14 @@ float Texture::get_height()
 {
     return m_height;
 }
+
+const fvec4& Texture::get_region()
+{
+    return m_region;
+}
+
+void Texture::set_region(TextureID id, const fvec4& region)
+{
+    m_id = id;
+    m_region = region;
+}
@@ -9,13 +9,21 @@ private:
     TextureID m_id;
     float m_width;
     float m_height;
+
+    //uv offset (xy) and scale (zw) inside the GL texture, only differs from the
+    //full texture for images placed in an atlas page
+    fvec4 m_region;
 public:
     Texture(TextureID id, float width, float height);
+    Texture(TextureID id, float width, float height, const fvec4& region);
     ~Texture();
 
     TextureID get_id();
     float get_width();
     float get_height();
+    const fvec4& get_region();
+
+    void set_region(TextureID id, const fvec4& region);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "TextureAtlas.h"
+#include "SkylinePacker.h"
+#include "LogSystem.h"
+#include "Texture.h"
+#include "GLState.h"
+
+#include <algorithm>
+
+TextureAtlas::TextureAtlas() :
+    m_pages(), m_retired(), m_repacks(0)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    collect();
+
+    for (auto& page : m_pages)
+    {
+        GLState::get()->delete_texture((uint32_t)page.id);
+    }
+}
+
+bool TextureAtlas::fits(int32_t width, int32_t height)
+{
+    return width > 0 && height > 0 && width <= MAX_ENTRY_SIZE && height <= MAX_ENTRY_SIZE;
+}
+
+TexturePtr TextureAtlas::insert(const uint8_t* pixels, int32_t width, int32_t height)
+{
+    if (!fits(width, height))
+        return nullptr;
+
+    for (auto& page : m_pages)
+    {
+        auto texture = place(page, pixels, width, height);
+        if (texture != nullptr)
+            return texture;
+    }
+
+    if (m_pages.size() < MAX_PAGES)
+    {
+        m_pages.emplace_back();
+        create_page(m_pages.back());
+
+        return place(m_pages.back(), pixels, width, height);
+    }
+
+    //every page is full, reclaim the one holding the most released entries
+    Page* victim = nullptr;
+    int64_t reclaimable = 0;
+
+    for (auto& page : m_pages)
+    {
+        auto dead = page.packer->get_used_area() - live_area(page);
+        if (dead > reclaimable)
+        {
+            reclaimable = dead;
+            victim = &page;
+        }
+    }
+
+    if (victim == nullptr || !repack(*victim))
+        return nullptr;
+
+    return place(*victim, pixels, width, height);
+}
+
+TexturePtr TextureAtlas::get_page(TextureID id)
+{
+    for (auto& page : m_pages)
+    {
+        if (page.id == id)
+            return page.texture;
+    }
+
+    return nullptr;
+}
+
+const vector<uint32_t>& TextureAtlas::get_retired()
+{
+    return m_retired;
+}
+
+void TextureAtlas::collect()
+{
+    for (auto id : m_retired)
+        GLState::get()->delete_texture(id);
+
+    m_retired.clear();
+}
+
+AtlasStats TextureAtlas::get_stats()
+{
+    AtlasStats stats = {};
+    stats.pages = (int32_t)m_pages.size();
+    stats.repacks = m_repacks;
+
+    for (auto& page : m_pages)
+    {
+        for (auto& entry : page.entries)
+        {
+            if (!entry.texture.expired())
+                stats.entries++;
+        }
+
+        stats.used_area += page.packer->get_used_area();
+        stats.live_area += live_area(page);
+        stats.total_area += (int64_t)PAGE_SIZE * PAGE_SIZE;
+    }
+
+    stats.occupancy = stats.total_area == 0 ? 0.0f : (float)((double)stats.live_area / stats.total_area);
+    return stats;
+}
+
+TexturePtr TextureAtlas::place(Page& page, const uint8_t* pixels, int32_t width, int32_t height)
+{
+    ivec2 position;
+    if (!page.packer->pack(width + PADDING, height + PADDING, position))
+        return nullptr;
+
+    Entry entry;
+    entry.rect = ivec4(position.x, position.y, width, height);
+    upload(page.id, entry.rect, pixels, width);
+
+    TexturePtr texture = NEW_4(Texture, page.id, (float)width, (float)height, region(entry.rect));
+    entry.texture = texture;
+    page.entries.push_back(move(entry));
+
+    return texture;
+}
+
+void TextureAtlas::create_page(Page& page)
+{
+    uint32_t texture;
+    glGenTextures(1, &texture);
+    CHECK_GL_ERROR;
+    GLState::get()->bind_texture(0, texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    CHECK_GL_ERROR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    CHECK_GL_ERROR;
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PAGE_SIZE, PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    CHECK_GL_ERROR;
+
+    page.id = texture;
+    page.texture = NEW_3(Texture, page.id, (float)PAGE_SIZE, (float)PAGE_SIZE);
+    page.packer = UNEW_2(SkylinePacker, PAGE_SIZE, PAGE_SIZE);
+}
+
+bool TextureAtlas::repack(Page& page)
+{
+    vector<Entry> entries;
+    for (auto& entry : page.entries)
+    {
+        if (!entry.texture.expired())
+            entries.push_back(entry);
+    }
+
+    //tallest first packs noticeably tighter with a skyline
+    sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.rect.w > b.rect.w; });
+
+    //laid out before anything is touched, a page whose live entries don't fit again is left as it is
+    auto packer = UNEW_2(SkylinePacker, PAGE_SIZE, PAGE_SIZE);
+    vector<ivec2> positions(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (!packer->pack(entries[i].rect.z + PADDING, entries[i].rect.w + PADDING, positions[i]))
+        {
+            LogSystem::get()->warn("Live atlas entries don't fit a repacked page, leaving it as it is");
+            return false;
+        }
+    }
+
+    //read back once instead of keeping a cpu copy of every entry around
+    vector<uint8_t> pixels((size_t)PAGE_SIZE * PAGE_SIZE * 4);
+    GLState::get()->bind_texture(0, (uint32_t)page.id);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    CHECK_GL_ERROR;
+
+    m_retired.push_back((uint32_t)page.id);
+    create_page(page);
+    page.packer = move(packer);
+    page.entries.clear();
+    m_repacks++;
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        auto& entry = entries[i];
+        auto texture = entry.texture.lock();
+        if (texture == nullptr)
+            continue;
+
+        auto* source = pixels.data() + ((size_t)entry.rect.y * PAGE_SIZE + entry.rect.x) * 4;
+        entry.rect.x = positions[i].x;
+        entry.rect.y = positions[i].y;
+        upload(page.id, entry.rect, source, PAGE_SIZE);
+
+        texture->set_region(page.id, region(entry.rect));
+        page.entries.push_back(move(entry));
+    }
+
+    return true;
+}
+
+void TextureAtlas::upload(TextureID id, const ivec4& rect, const uint8_t* pixels, int32_t stride)
+{
+    GLState::get()->bind_texture(0, (uint32_t)id);
+
+    if (stride != rect.z)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+        CHECK_GL_ERROR;
+    }
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.z, rect.w, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    CHECK_GL_ERROR;
+
+    if (stride != rect.z)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        CHECK_GL_ERROR;
+    }
+}
+
+int64_t TextureAtlas::live_area(Page& page)
+{
+    int64_t area = 0;
+    for (auto& entry : page.entries)
+    {
+        if (!entry.texture.expired())
+            area += (int64_t)(entry.rect.z + PADDING) * (entry.rect.w + PADDING);
+    }
+
+    return area;
+}
+
+fvec4 TextureAtlas::region(const ivec4& rect)
+{
+    float scale = 1.0f / PAGE_SIZE;
+    return fvec4(rect.x * scale, rect.y * scale, rect.z * scale, rect.w * scale);
+}
@@ -0,0 +1,72 @@
+#ifndef _TEXTURE_ATLAS_H_
+#define _TEXTURE_ATLAS_H_
+
+#include "Config.h"
+
+class SkylinePacker;
+
+struct AtlasStats
+{
+    int32_t pages;
+    int32_t entries;
+    int32_t repacks;
+    int64_t used_area;
+    int64_t live_area;
+    int64_t total_area;
+    float occupancy;
+};
+
+//Packs small images into shared pages so textures drawn after each other can
+//end up in the same batch. Entries whose Texture has been released are only
+//reclaimed when a page gets repacked, the replaced page texture is kept alive
+//until collect() so batches recorded this frame keep sampling valid data.
+//Pixels only live on the gpu, a repack reads the old page back. When the live
+//entries wouldn't fit a fresh page again the repack is skipped and insert fails.
+class TextureAtlas
+{
+private:
+    static const int32_t PAGE_SIZE = 2048;
+    static const int32_t MAX_PAGES = 8;
+    static const int32_t MAX_ENTRY_SIZE = 256;
+    static const int32_t PADDING = 1;
+
+    struct Entry
+    {
+        weak_ptr<Texture> texture;
+        ivec4 rect;
+    };
+
+    struct Page
+    {
+        TextureID id;
+        TexturePtr texture;
+        UPTR(SkylinePacker) packer;
+        vector<Entry> entries;
+    };
+
+    vector<Page> m_pages;
+    vector<uint32_t> m_retired;
+    int32_t m_repacks;
+public:
+    TextureAtlas();
+    ~TextureAtlas();
+
+    bool fits(int32_t width, int32_t height);
+    TexturePtr insert(const uint8_t* pixels, int32_t width, int32_t height);
+    //the whole page an entry's id refers to
+    TexturePtr get_page(TextureID id);
+    //page ids replaced by repacks, deleted on the next collect()
+    const vector<uint32_t>& get_retired();
+    void collect();
+
+    AtlasStats get_stats();
+private:
+    TexturePtr place(Page& page, const uint8_t* pixels, int32_t width, int32_t height);
+    void create_page(Page& page);
+    bool repack(Page& page);
+    void upload(TextureID id, const ivec4& rect, const uint8_t* pixels, int32_t stride);
+    int64_t live_area(Page& page);
+    fvec4 region(const ivec4& rect);
+};
+
+#endif
@@ -0,0 +1,419 @@
+#include "Triangulate.h"
+
+#include <algorithm>
+#include <cfloat>
+
+static const size_t SIMPLE_TESTS_PER_POINT = 64;
+static const size_t MIN_SIMPLE_TESTS = 1 << 20;
+
+//exact for float inputs, dense curves have corners far below float precision
+static inline double cross(const fvec2& a, const fvec2& b, const fvec2& c)
+{
+    return ((double)b.x - a.x) * ((double)c.y - a.y) - ((double)b.y - a.y) * ((double)c.x - a.x);
+}
+
+static inline int32_t sign(double value)
+{
+    return (value > 0.0f) - (value < 0.0f);
+}
+
+static bool segments_touch(const fvec2& a, const fvec2& b, const fvec2& c, const fvec2& d)
+{
+    auto d1 = sign(cross(a, b, c));
+    auto d2 = sign(cross(a, b, d));
+    auto d3 = sign(cross(c, d, a));
+    auto d4 = sign(cross(c, d, b));
+
+    if (d1 != d2 && d3 != d4)
+        return true;
+
+    //collinear overlaps
+    auto within = [](const fvec2& p, const fvec2& q, const fvec2& r)
+    {
+        return r.x >= min(p.x, q.x) && r.x <= max(p.x, q.x) && r.y >= min(p.y, q.y) && r.y <= max(p.y, q.y);
+    };
+
+    return (d1 == 0 && within(a, b, c)) || (d2 == 0 && within(a, b, d)) || (d3 == 0 && within(c, d, a)) || (d4 == 0 && within(c, d, b));
+}
+
+//uniform grid over the polygon's bounds with about one cell per point
+class PointGrid
+{
+private:
+    fvec2 m_origin;
+    fvec2 m_scale;
+    int32_t m_size;
+public:
+    vector<vector<uint32_t>> cells;
+
+    PointGrid(const fvec2* points, size_t count) :
+        m_origin(FLT_MAX, FLT_MAX), m_scale(), m_size(max(1, min(1024, (int32_t)sqrtf((float)count)))), cells()
+    {
+        fvec2 end(-FLT_MAX, -FLT_MAX);
+        for (size_t i = 0; i < count; i++)
+        {
+            m_origin.x = min(m_origin.x, points[i].x);
+            m_origin.y = min(m_origin.y, points[i].y);
+            end.x = max(end.x, points[i].x);
+            end.y = max(end.y, points[i].y);
+        }
+
+        //slightly larger than the bounds so the far edge still lands in the last cell
+        m_scale.x = end.x > m_origin.x ? m_size / ((end.x - m_origin.x) * 1.001f) : 0.0f;
+        m_scale.y = end.y > m_origin.y ? m_size / ((end.y - m_origin.y) * 1.001f) : 0.0f;
+        cells.resize(m_size * m_size);
+    }
+
+    //visits the cells the segment passes through
+    template<typename F>
+    void trace(const fvec2& a, const fvec2& b, F visit)
+    {
+        fvec2 p((a.x - m_origin.x) * m_scale.x, (a.y - m_origin.y) * m_scale.y);
+        fvec2 q((b.x - m_origin.x) * m_scale.x, (b.y - m_origin.y) * m_scale.y);
+
+        auto x = max(0, min(m_size - 1, (int32_t)p.x));
+        auto y = max(0, min(m_size - 1, (int32_t)p.y));
+        auto end_x = max(0, min(m_size - 1, (int32_t)q.x));
+        auto end_y = max(0, min(m_size - 1, (int32_t)q.y));
+
+        auto step_x = end_x > x ? 1 : -1;
+        auto step_y = end_y > y ? 1 : -1;
+        auto dx = fabsf(q.x - p.x);
+        auto dy = fabsf(q.y - p.y);
+
+        //parameter along the segment of the next cell boundary on either axis
+        auto next_x = dx > 0.0f ? (step_x > 0 ? x + 1 - p.x : p.x - x) / dx : FLT_MAX;
+        auto next_y = dy > 0.0f ? (step_y > 0 ? y + 1 - p.y : p.y - y) / dy : FLT_MAX;
+
+        visit(at(x, y));
+        while (x != end_x || y != end_y)
+        {
+            if (y == end_y || (x != end_x && next_x < next_y))
+            {
+                x += step_x;
+                next_x += 1.0f / dx;
+            }
+            else
+            {
+                y += step_y;
+                next_y += 1.0f / dy;
+            }
+
+            visit(at(x, y));
+        }
+    }
+
+    ivec4 range(const fvec2& a, const fvec2& b)
+    {
+        auto cell = [this](float value, float origin, float scale)
+        {
+            return max(0, min(m_size - 1, (int32_t)((value - origin) * scale)));
+        };
+
+        return ivec4(cell(min(a.x, b.x), m_origin.x, m_scale.x), cell(min(a.y, b.y), m_origin.y, m_scale.y),
+            cell(max(a.x, b.x), m_origin.x, m_scale.x), cell(max(a.y, b.y), m_origin.y, m_scale.y));
+    }
+
+    vector<uint32_t>& at(int32_t x, int32_t y)
+    {
+        return cells[y * m_size + x];
+    }
+};
+
+bool polygon_convex(const fvec2* points, size_t count)
+{
+    if (count < 3)
+        return false;
+
+    //turning the same way everywhere is not enough for rings that wind around twice,
+    //those change horizontal direction more than twice
+    int32_t turn = 0;
+    int32_t direction = 0;
+    int32_t flips = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& a = points[i];
+        auto& b = points[(i + 1) % count];
+        auto& c = points[(i + 2) % count];
+
+        auto side = sign(cross(a, b, c));
+        if (side != 0)
+        {
+            if (turn != 0 && side != turn)
+                return false;
+
+            turn = side;
+        }
+
+        auto heading = sign(b.x - a.x);
+        if (heading != 0)
+        {
+            if (direction != 0 && heading != direction)
+                flips++;
+
+            direction = heading;
+        }
+    }
+
+    //the wrap around from the last edge back to the first counts too
+    for (size_t i = 0; i < count; i++)
+    {
+        auto heading = sign(points[(i + 1) % count].x - points[i].x);
+        if (heading == 0)
+            continue;
+
+        if (heading != direction)
+            flips++;
+        break;
+    }
+
+    return turn != 0 && flips <= 2;
+}
+
+bool polygon_simple(const fvec2* points, size_t count)
+{
+    if (count < 3)
+        return false;
+
+    PointGrid grid(points, count);
+    for (size_t i = 0; i < count; i++)
+    {
+        grid.trace(points[i], points[(i + 1) % count], [i](vector<uint32_t>& cell) { cell.push_back((uint32_t)i); });
+    }
+
+    auto budget = max(count * SIMPLE_TESTS_PER_POINT, MIN_SIMPLE_TESTS);
+    for (auto& cell : grid.cells)
+    {
+        auto pairs = cell.size() * (cell.size() - min(cell.size(), (size_t)1)) / 2;
+        if (pairs > budget)
+            return false;
+
+        budget -= pairs;
+        for (size_t i = 0; i < cell.size(); i++)
+        {
+            for (size_t j = i + 1; j < cell.size(); j++)
+            {
+                auto a = cell[i];
+                auto b = cell[j];
+
+                //neighbours share a point
+                if (b - a == 1 || (a == 0 && b == count - 1))
+                    continue;
+
+                if (segments_touch(points[a], points[(a + 1) % count], points[b], points[(b + 1) % count]))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool point_in_ring(const fvec2& point, const fvec2* points, size_t count)
+{
+    bool inside = false;
+    for (size_t i = 0, j = count - 1; i < count; j = i++)
+    {
+        auto& a = points[i];
+        auto& b = points[j];
+
+        if ((a.y > point.y) != (b.y > point.y) && point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x)
+            inside = !inside;
+    }
+
+    return inside;
+}
+
+void triangulate_fan(size_t count, uint32_t base, vector<uint32_t>& indices)
+{
+    for (uint32_t i = 2; i < (uint32_t)count; i++)
+    {
+        indices.push_back(base);
+        indices.push_back(base + i - 1);
+        indices.push_back(base + i);
+    }
+}
+
+bool triangulate(const fvec2* points, size_t count, uint32_t base, vector<uint32_t>& indices)
+{
+    if (count < 3)
+        return false;
+
+    double area = 0.0;
+    for (size_t i = 0, j = count - 1; i < count; j = i++)
+        area += ((double)points[j].x - points[i].x) * ((double)points[j].y + points[i].y);
+
+    //corners turning with the winding are convex
+    double winding = area > 0.0 ? 1.0 : -1.0;
+    if (area == 0.0)
+        return false;
+
+    vector<uint32_t> prev(count);
+    vector<uint32_t> next(count);
+    vector<uint8_t> reflex(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        prev[i] = (uint32_t)(i == 0 ? count - 1 : i - 1);
+        next[i] = (uint32_t)(i == count - 1 ? 0 : i + 1);
+    }
+
+    auto is_reflex = [&](uint32_t i)
+    {
+        return cross(points[prev[i]], points[i], points[next[i]]) * winding < 0.0;
+    };
+
+    //only reflex points can end up inside an ear, they're the only ones kept in the grid.
+    //Clipping ears never makes a convex corner reflex, so the grid never needs new entries
+    PointGrid grid(points, count);
+    vector<uint32_t> reflex_points;
+    for (uint32_t i = 0; i < (uint32_t)count; i++)
+    {
+        reflex[i] = is_reflex(i);
+        if (!reflex[i])
+            continue;
+
+        auto range = grid.range(points[i], points[i]);
+        grid.at(range.x, range.y).push_back(i);
+        reflex_points.push_back(i);
+    }
+
+    size_t live = reflex_points.size();
+
+    auto is_ear = [&](uint32_t i)
+    {
+        if (reflex[i])
+            return false;
+
+        auto& a = points[prev[i]];
+        auto& b = points[i];
+        auto& c = points[next[i]];
+
+        auto inside = [&](uint32_t candidate)
+        {
+            if (candidate == prev[i] || candidate == next[i])
+                return false;
+
+            auto& p = points[candidate];
+            if (p == a || p == c)
+                return false;
+
+            //points on the ear's edges don't block it, dense curves are full of them
+            return cross(a, b, p) * winding > 0.0 && cross(b, c, p) * winding > 0.0 && cross(c, a, p) * winding > 0.0;
+        };
+
+        auto range = grid.range(a, b);
+        auto far = grid.range(c, c);
+        range = ivec4(min(range.x, far.x), min(range.y, far.y), max(range.z, far.z), max(range.w, far.w));
+
+        //large ears late in the clipping cover many cells but few reflex points remain
+        if ((size_t)(range.z - range.x + 1) * (range.w - range.y + 1) > reflex_points.size())
+        {
+            if (reflex_points.size() > live * 2)
+                reflex_points.erase(remove_if(reflex_points.begin(), reflex_points.end(), [&](uint32_t p) { return !reflex[p]; }), reflex_points.end());
+
+            for (auto candidate : reflex_points)
+            {
+                if (reflex[candidate] && inside(candidate))
+                    return false;
+            }
+
+            return true;
+        }
+
+        for (int32_t y = range.y; y <= range.w; y++)
+        {
+            for (int32_t x = range.x; x <= range.z; x++)
+            {
+                auto& cell = grid.at(x, y);
+                for (size_t k = 0; k < cell.size();)
+                {
+                    //drop points that turned convex on the way
+                    if (!reflex[cell[k]])
+                    {
+                        cell[k] = cell.back();
+                        cell.pop_back();
+                        continue;
+                    }
+
+                    if (inside(cell[k++]))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    };
+
+    auto update = [&](uint32_t i)
+    {
+        if (reflex[i] && !is_reflex(i))
+        {
+            reflex[i] = 0;
+            live--;
+        }
+    };
+
+    auto start = indices.size();
+    indices.reserve(start + (count - 2) * 3);
+
+    uint32_t current = 0;
+    size_t remaining = count;
+    size_t stalled = 0;
+
+    while (remaining > 3)
+    {
+        //what's left is convex
+        if (live == 0)
+        {
+            for (auto i = next[next[current]]; i != current; i = next[i])
+            {
+                indices.push_back(base + current);
+                indices.push_back(base + prev[i]);
+                indices.push_back(base + i);
+            }
+
+            return true;
+        }
+
+        //a full lap without an ear means the ring wasn't simple after all
+        if (stalled >= remaining)
+        {
+            indices.resize(start);
+            return false;
+        }
+
+        if (!is_ear(current))
+        {
+            current = next[current];
+            stalled++;
+            continue;
+        }
+
+        auto a = prev[current];
+        auto c = next[current];
+
+        indices.push_back(base + a);
+        indices.push_back(base + current);
+        indices.push_back(base + c);
+
+        next[a] = c;
+        prev[c] = a;
+        remaining--;
+
+        update(a);
+        update(c);
+
+        //skipping past the new corner keeps ears small and spread around the ring,
+        //going back to a would fan everything out of one point
+        current = next[c];
+        stalled = 0;
+    }
+
+    indices.push_back(base + prev[current]);
+    indices.push_back(base + current);
+    indices.push_back(base + next[current]);
+
+    return true;
+}
@@ -0,0 +1,22 @@
+#ifndef _TRIANGULATE_H_
+#define _TRIANGULATE_H_
+
+#include "Config.h"
+
+//Polygons are a closed ring of points without the first one repeated at the end.
+//Indices are written relative to base so several rings can share one vertex list
+
+bool polygon_convex(const fvec2* points, size_t count);
+//whether no two edges that aren't neighbours touch. Rings too dense to tell in
+//roughly linear time are reported as not simple, the stencil fill handles those anyway
+bool polygon_simple(const fvec2* points, size_t count);
+
+//even-odd crossing test
+bool point_in_ring(const fvec2& point, const fvec2* points, size_t count);
+
+void triangulate_fan(size_t count, uint32_t base, vector<uint32_t>& indices);
+//ear clipping for simple polygons of either winding, returns false and leaves indices
+//untouched when the ring turns out not to be simple
+bool triangulate(const fvec2* points, size_t count, uint32_t base, vector<uint32_t>& indices);
+
+#endif
@@ -0,0 +1,58 @@
+#include "UniformBuffer.h"
+#include "GLState.h"
+
+UniformBuffer::UniformBuffer(uint32_t binding, size_t size) :
+    m_buffer(0), m_binding(binding), m_size(size)
+{
+    glGenBuffers(1, &m_buffer);
+    CHECK_GL_ERROR;
+
+    GLState::get()->bind_buffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+    CHECK_GL_ERROR;
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    GLState::get()->delete_buffer(m_buffer);
+}
+
+void UniformBuffer::update(const void* data, size_t size)
+{
+    //orphan first so the driver doesn't stall on the previous frame still reading it
+    GLState::get()->bind_buffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+    CHECK_GL_ERROR;
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, min(size, m_size), data);
+    CHECK_GL_ERROR;
+}
+
+void UniformBuffer::bind()
+{
+    GLState::get()->bind_buffer_base(GL_UNIFORM_BUFFER, m_binding, m_buffer);
+}
+
+uint32_t UniformBuffer::get_binding()
+{
+    return m_binding;
+}
+
+void UniformBuffer::attach(uint32_t program)
+{
+    static const struct { const char* name; uint32_t binding; } blocks[] =
+    {
+        { "FrameData", FRAME_BINDING }
+    };
+
+    for (auto& block : blocks)
+    {
+        auto index = glGetUniformBlockIndex(program, block.name);
+        CHECK_GL_ERROR;
+
+        if (index == GL_INVALID_INDEX)
+            continue;
+
+        glUniformBlockBinding(program, index, block.binding);
+        CHECK_GL_ERROR;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef _UNIFORM_BUFFER_H_
+#define _UNIFORM_BUFFER_H_
+
+#include "Config.h"
+
+//std140 mirror of FRAME_DATA_BLOCK, keep both in sync
+struct FrameData
+{
+    fmatrix4 projection;
+    fvec4 viewport;
+    float time;
+    float delta_time;
+    float padding[2];
+};
+
+//per-frame values shared by every shader, paste it after the #version line
+#define FRAME_DATA_BLOCK \
+    "layout(std140) uniform FrameData                           \r\n" \
+    "{                                                          \r\n" \
+    "    mat4 projection;                                       \r\n" \
+    "    vec4 viewport;                                         \r\n" \
+    "    float time;                                            \r\n" \
+    "    float delta_time;                                      \r\n" \
+    "};                                                         \r\n"
+
+//Uniform buffer attached to a fixed binding point. Programs get their blocks
+//pointed at the binding points once after linking, so switching programs
+//doesn't touch any of the shared values.
+class UniformBuffer
+{
+public:
+    static const uint32_t FRAME_BINDING = 0;
+private:
+    uint32_t m_buffer;
+    uint32_t m_binding;
+    size_t m_size;
+public:
+    UniformBuffer(uint32_t binding, size_t size);
+    ~UniformBuffer();
+
+    void update(const void* data, size_t size);
+    void bind();
+
+    uint32_t get_binding();
+
+    static void attach(uint32_t program);
+};
+
+#endif
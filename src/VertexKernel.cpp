@@ -0,0 +1,219 @@
+#include "VertexKernel.h"
+
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+VertexTransform::VertexTransform() :
+    m00(1.0f), m01(0.0f), m10(0.0f), m11(1.0f), m30(0.0f), m31(0.0f),
+    region(0.0f, 0.0f, 1.0f, 1.0f), color(0xFFFFFFFF), slot(0)
+{
+}
+
+VertexTransform::VertexTransform(const fmatrix4& matrix, const fvec4& uv_region, uint32_t modulate, uint32_t texture_slot, bool flipped_y, float viewport_height) :
+    m00(matrix[0][0]), m01(matrix[0][1]), m10(matrix[1][0]), m11(matrix[1][1]), m30(matrix[3][0]), m31(matrix[3][1]),
+    region(uv_region), color(modulate), slot(texture_slot)
+{
+    //y' = h - y
+    if (flipped_y)
+    {
+        m01 = -m01;
+        m11 = -m11;
+        m31 = viewport_height - m31;
+    }
+}
+
+VertexTransform::VertexTransform(RenderState* state, TexturePtr texture, bool flipped_y, float viewport_height) :
+    VertexTransform(state->matrix(), texture == nullptr ? fvec4(0.0f, 0.0f, 1.0f, 1.0f) : texture->get_region(),
+        (Color(state->color()) * state->opacity()).uint, 0, flipped_y, viewport_height)
+{
+}
+
+//a * b / 255 rounded, exact for every pair of bytes
+static inline uint32_t mul_channel(uint32_t a, uint32_t b)
+{
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline uint32_t mul_color(uint32_t a, uint32_t b)
+{
+    return mul_channel(a & 0xFF, b & 0xFF) |
+        (mul_channel((a >> 8) & 0xFF, (b >> 8) & 0xFF) << 8) |
+        (mul_channel((a >> 16) & 0xFF, (b >> 16) & 0xFF) << 16) |
+        (mul_channel(a >> 24, b >> 24) << 24);
+}
+
+static inline void transform_scalar(const VertexTransform& transform, const VertexData& source, VertexData& target)
+{
+    target.v.x = transform.m00 * source.v.x + transform.m10 * source.v.y + transform.m30;
+    target.v.y = transform.m01 * source.v.x + transform.m11 * source.v.y + transform.m31;
+    target.uv.x = transform.region.x + source.uv.x * transform.region.z;
+    target.uv.y = transform.region.y + source.uv.y * transform.region.w;
+    target.color = mul_color(source.color, transform.color);
+    target.slot = transform.slot;
+}
+
+#ifdef VERTEX_KERNEL_SSE2
+void transform_vertices(const VertexTransform& transform, const VertexData* source, VertexData* target, size_t count)
+{
+    //(x, x, u, v) * scale + (y, y, y, y) * shear + offset covers position and uv in one go
+    const __m128 scale = _mm_setr_ps(transform.m00, transform.m01, transform.region.z, transform.region.w);
+    const __m128 shear = _mm_setr_ps(transform.m10, transform.m11, 0.0f, 0.0f);
+    const __m128 offset = _mm_setr_ps(transform.m30, transform.m31, transform.region.x, transform.region.y);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i modulate = _mm_unpacklo_epi8(_mm_set1_epi32((int32_t)transform.color), zero);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        for (size_t j = 0; j < 4; j++)
+        {
+            __m128 vertex = _mm_loadu_ps(&source[i + j].v.x);
+            __m128 xxuv = _mm_shuffle_ps(vertex, vertex, _MM_SHUFFLE(3, 2, 0, 0));
+            __m128 yyyy = _mm_shuffle_ps(vertex, vertex, _MM_SHUFFLE(1, 1, 1, 1));
+            __m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xxuv, scale), _mm_mul_ps(yyyy, shear)), offset);
+            _mm_storeu_ps(&target[i + j].v.x, result);
+        }
+
+        //four packed colors, widened to 16 bits per channel, multiplied and divided by 255 with rounding
+        __m128i colors = _mm_setr_epi32((int32_t)source[i].color, (int32_t)source[i + 1].color,
+            (int32_t)source[i + 2].color, (int32_t)source[i + 3].color);
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(colors, zero), modulate), half);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(colors, zero), modulate), half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        alignas(16) uint32_t packed[4];
+        _mm_store_si128((__m128i*)packed, _mm_packus_epi16(lo, hi));
+
+        for (size_t j = 0; j < 4; j++)
+        {
+            target[i + j].color = packed[j];
+            target[i + j].slot = transform.slot;
+        }
+    }
+
+    for (; i < count; i++)
+        transform_scalar(transform, source[i], target[i]);
+}
+#else
+void transform_vertices(const VertexTransform& transform, const VertexData* source, VertexData* target, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        transform_scalar(transform, source[i], target[i]);
+}
+#endif
+
+void transform_sprite(const VertexTransform& transform, float x, float y, float w, float h, SpriteInstance& target)
+{
+    target.axis_x = fvec2(transform.m00 * w, transform.m01 * w);
+    target.axis_y = fvec2(transform.m10 * h, transform.m11 * h);
+    target.origin.x = transform.m00 * x + transform.m10 * y + transform.m30;
+    target.origin.y = transform.m01 * x + transform.m11 * y + transform.m31;
+    map_sprite_region(transform.region, target);
+    target.color = transform.color;
+    target.slot = transform.slot;
+}
+
+void map_sprite_region(const fvec4& region, SpriteInstance& target)
+{
+    target.region[0] = (uint16_t)(region.x * 65535.0f + 0.5f);
+    target.region[1] = (uint16_t)(region.y * 65535.0f + 0.5f);
+    target.region[2] = (uint16_t)(region.z * 65535.0f + 0.5f);
+    target.region[3] = (uint16_t)(region.w * 65535.0f + 0.5f);
+}
+
+void transform_line(const VertexTransform& transform, float x1, float y1, float x2, float y2, float half_width, SpriteInstance& target)
+{
+    target.origin.x = transform.m00 * x1 + transform.m10 * y1 + transform.m30;
+    target.origin.y = transform.m01 * x1 + transform.m11 * y1 + transform.m31;
+    target.axis_x.x = transform.m00 * (x2 - x1) + transform.m10 * (y2 - y1);
+    target.axis_x.y = transform.m01 * (x2 - x1) + transform.m11 * (y2 - y1);
+
+    //widths scale with the area of the transform, non uniform scales only get an average
+    target.axis_y = fvec2(half_width * sqrtf(fabsf(transform.m00 * transform.m11 - transform.m01 * transform.m10)), 0.0f);
+
+    memset(target.region, 0, sizeof(target.region));
+    target.color = transform.color;
+    target.slot = 0;
+}
+
+//sine of the bisector against the segment's normal, 0 is left for a plain round cap
+static uint16_t pack_join(const fvec2& direction, const fvec2& bisector)
+{
+    float sine = bisector.x * -direction.y + bisector.y * direction.x;
+    return (uint16_t)(1.0f + (min(max(sine, -1.0f), 1.0f) + 1.0f) * 32767.0f + 0.5f);
+}
+
+void join_lines(SpriteInstance& previous, SpriteInstance& next)
+{
+    float previous_length = glm::length(previous.axis_x);
+    float next_length = glm::length(next.axis_x);
+    if (previous_length <= 0.0f || next_length <= 0.0f)
+        return;
+
+    fvec2 a = previous.axis_x / previous_length;
+    fvec2 b = next.axis_x / next_length;
+
+    //a line folding back onto itself has no usable bisector, the caps just overlap there
+    fvec2 bisector = a + b;
+    float length = glm::length(bisector);
+    if (length < 1e-3f)
+        return;
+
+    bisector = bisector / length;
+    previous.region[1] = pack_join(a, bisector);
+    next.region[0] = pack_join(b, bisector);
+}
+
+fvec4 get_vertex_bounds(const VertexData* vertices, size_t count)
+{
+    if (count == 0)
+        return fvec4();
+
+    fvec4 bounds(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t i = 0; i < count; i++)
+    {
+        bounds.x = min(bounds.x, vertices[i].v.x);
+        bounds.y = min(bounds.y, vertices[i].v.y);
+        bounds.z = max(bounds.z, vertices[i].v.x);
+        bounds.w = max(bounds.w, vertices[i].v.y);
+    }
+
+    return bounds;
+}
+
+fvec4 get_line_bounds(const SpriteInstance& instance)
+{
+    //round caps plus the pixel the edge fades out in
+    float reach = instance.axis_y.x + 1.0f;
+    fvec2 end = instance.origin + instance.axis_x;
+
+    return fvec4(min(instance.origin.x, end.x) - reach, min(instance.origin.y, end.y) - reach,
+        max(instance.origin.x, end.x) + reach, max(instance.origin.y, end.y) + reach);
+}
+
+fvec4 get_sprite_bounds(const SpriteInstance& instance)
+{
+    fvec4 bounds(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int32_t i = 0; i < 4; i++)
+    {
+        fvec2 corner = instance.origin;
+        if (i & 1) corner += instance.axis_x;
+        if (i & 2) corner += instance.axis_y;
+
+        bounds.x = min(bounds.x, corner.x);
+        bounds.y = min(bounds.y, corner.y);
+        bounds.z = max(bounds.z, corner.x);
+        bounds.w = max(bounds.w, corner.y);
+    }
+
+    return bounds;
+}
@@ -0,0 +1,45 @@
+#ifndef _VERTEX_KERNEL_H_
+#define _VERTEX_KERNEL_H_
+
+#include "Config.h"
+#include "Canvas.h"
+
+//Everything RenderLayer applies to a submitted vertex, folded into constants
+//once per draw. The y flip is baked into the affine part so the kernel never branches on it.
+struct VertexTransform
+{
+    float m00, m01;
+    float m10, m11;
+    float m30, m31;
+    fvec4 region;
+    uint32_t color;
+    uint32_t slot;
+
+    VertexTransform();
+    VertexTransform(const fmatrix4& matrix, const fvec4& uv_region, uint32_t modulate, uint32_t texture_slot, bool flipped_y, float viewport_height);
+    VertexTransform(RenderState* state, TexturePtr texture, bool flipped_y, float viewport_height);
+};
+
+//transforms count vertices from source into target, remapping uvs into the
+//region and multiplying every packed color channel with the modulate color
+void transform_vertices(const VertexTransform& transform, const VertexData* source, VertexData* target, size_t count);
+
+//places the unit quad at (x, y, w, h) in local space, the transform's slot is left for the layer to assign
+void transform_sprite(const VertexTransform& transform, float x, float y, float w, float h, SpriteInstance& target);
+
+//quantizes the uv region into the instance, sprites recorded off the context thread get theirs on replay
+void map_sprite_region(const fvec4& region, SpriteInstance& target);
+
+//segments for the line shader reuse the sprite layout: origin is the start, axis_x runs to
+//the end and axis_y.x holds the half width after the transform
+void transform_line(const VertexTransform& transform, float x1, float y1, float x2, float y2, float half_width, SpriteInstance& target);
+
+//splits the joint between two consecutive segments along its bisector so the round caps meeting
+//there cover every pixel once, region[0] and region[1] hold the clip at the start and end of a line
+void join_lines(SpriteInstance& previous, SpriteInstance& next);
+
+fvec4 get_vertex_bounds(const VertexData* vertices, size_t count);
+fvec4 get_sprite_bounds(const SpriteInstance& instance);
+fvec4 get_line_bounds(const SpriteInstance& instance);
+
+#endif
@@ -6,7 +6,7 @@ static bool sdl_setup = false;
 static bool glad_setup = false;
 static int window_ref_count = 0;
 
-Window::Window() : m_window(nullptr), m_context(nullptr), m_input(NEW_0(Input))
+Window::Window() : m_window(nullptr), m_context(nullptr), m_input(NEW_0(Input)), m_presented_frames(0), m_skipped_frames(0)
 {
     window_ref_count++;
 }
@@ -20,13 +20,17 @@ Window::~Window()
         deinitialise_sdl();
 }
 
-bool Window::open(const string& title, uint32_t w, uint32_t h, bool fullscreen)
+bool Window::open(const string& title, uint32_t w, uint32_t h, bool fullscreen, int32_t samples)
 {
     if (m_window != nullptr)
         return true;
 
     initialise_sdl();
 
+    //the pixel format is picked when the window is created on some platforms
+    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, samples > 0 ? 1 : 0);
+    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, max(samples, 0));
+
     auto flags = SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI;
     if (fullscreen)
     {
@@ -46,6 +50,7 @@ bool Window::open(const string& title, uint32_t w, uint32_t h, bool fullscreen)
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 
     m_context = SDL_GL_CreateContext(m_window);
@@ -85,6 +90,26 @@ void Window::make_current()
 void Window::swap()
 {
     SDL_GL_SwapWindow(m_window);
+    m_presented_frames++;
+}
+
+void Window::skip_frame()
+{
+    m_skipped_frames++;
+}
+
+void Window::request_redraw()
+{
+    //safe from any thread, wakes up a blocking event_tick
+    SDL_Event event = {};
+    event.type = SDL_USEREVENT;
+    SDL_PushEvent(&event);
+}
+
+float Window::get_idle_ratio()
+{
+    auto total = m_presented_frames + m_skipped_frames;
+    return total == 0 ? 0.0f : (float)((double)m_skipped_frames / total);
 }
 
 void Window::close()
@@ -129,83 +154,97 @@ SDL_Window* Window::get_handle()
     return m_window;
 }
 
-bool Window::event_tick()
+bool Window::event_tick(int32_t wait_timeout)
 {
     static SDL_Event event;
 
+    if (wait_timeout > 0 && SDL_WaitEventTimeout(&event, wait_timeout))
+    {
+        if (!handle_event(event))
+            return false;
+    }
+
     while (SDL_PollEvent(&event))
     {
-        if (event.type == SDL_QUIT)
-        {
+        if (!handle_event(event))
             return false;
-        }
-        else if (event.type == SDL_KEYDOWN)
-        {
-            m_input->_notify_key_press(event.key.keysym.sym);
-        }
-        else if (event.type == SDL_KEYUP)
-        {
-            m_input->_notify_key_release(event.key.keysym.sym);
-        }
-        else if (event.type == SDL_MOUSEMOTION)
-        {
-            m_input->_notify_mouse_move((float)event.motion.x, (float)event.motion.y);
-        }
-        else if (event.type == SDL_MOUSEBUTTONDOWN)
-        {
-            switch (event.button.button)
-            {
-                case 0:
-                    m_input->_notify_key_press(SDLK_mouse_4);
-                    break;
-
-                case 1:
-                    m_input->_notify_key_press(SDLK_mouse_left);
-                    break;
-
-                case 2:
-                    m_input->_notify_key_press(SDLK_mouse_middle);
-                    break;
-
-                case 3:
-                    m_input->_notify_key_press(SDLK_mouse_right);
-                    break;
-
-                case 4:
-                    m_input->_notify_key_press(SDLK_mouse_5);
-                    break;
-            }
-        }
-        else if (event.type == SDL_MOUSEBUTTONUP)
+    }
+
+    return true;
+}
+
+bool Window::handle_event(const SDL_Event& event)
+{
+    if (event.type == SDL_QUIT)
+    {
+        return false;
+    }
+    else if (event.type == SDL_KEYDOWN)
+    {
+        m_input->_notify_key_press(event.key.keysym.sym);
+    }
+    else if (event.type == SDL_KEYUP)
+    {
+        m_input->_notify_key_release(event.key.keysym.sym);
+    }
+    else if (event.type == SDL_MOUSEMOTION)
+    {
+        m_input->_notify_mouse_move((float)event.motion.x, (float)event.motion.y);
+    }
+    else if (event.type == SDL_MOUSEBUTTONDOWN)
+    {
+        switch (event.button.button)
         {
-            switch (event.button.button)
-            {
-                case 0:
-                    m_input->_notify_key_release(SDLK_mouse_4);
-                    break;
-
-                case 1:
-                    m_input->_notify_key_release(SDLK_mouse_left);
-                    break;
-
-                case 2:
-                    m_input->_notify_key_release(SDLK_mouse_middle);
-                    break;
-
-                case 3:
-                    m_input->_notify_key_release(SDLK_mouse_right);
-                    break;
-
-                case 4:
-                    m_input->_notify_key_release(SDLK_mouse_5);
-                    break;
-            }
+            case 0:
+                m_input->_notify_key_press(SDLK_mouse_4);
+                break;
+
+            case 1:
+                m_input->_notify_key_press(SDLK_mouse_left);
+                break;
+
+            case 2:
+                m_input->_notify_key_press(SDLK_mouse_middle);
+                break;
+
+            case 3:
+                m_input->_notify_key_press(SDLK_mouse_right);
+                break;
+
+            case 4:
+                m_input->_notify_key_press(SDLK_mouse_5);
+                break;
         }
-        else if (event.type == SDL_MOUSEWHEEL)
+    }
+    else if (event.type == SDL_MOUSEBUTTONUP)
+    {
+        switch (event.button.button)
         {
-            m_input->_notify_mouse_scroll((float)event.wheel.y);
+            case 0:
+                m_input->_notify_key_release(SDLK_mouse_4);
+                break;
+
+            case 1:
+                m_input->_notify_key_release(SDLK_mouse_left);
+                break;
+
+            case 2:
+                m_input->_notify_key_release(SDLK_mouse_middle);
+                break;
+
+            case 3:
+                m_input->_notify_key_release(SDLK_mouse_right);
+                break;
+
+            case 4:
+                m_input->_notify_key_release(SDLK_mouse_5);
+                break;
         }
     }
+    else if (event.type == SDL_MOUSEWHEEL)
+    {
+        m_input->_notify_mouse_scroll((float)event.wheel.y);
+    }
 
     return true;
 }
@@ -18,11 +18,15 @@ private:
 
     float m_scale_width;
     float m_scale_height;
+
+    uint64_t m_presented_frames;
+    uint64_t m_skipped_frames;
 public:
     Window();
     ~Window();
 
-    bool open(const string& title, uint32_t w, uint32_t h, bool fullscreen = false);
+    //samples above 0 request a multisampled back buffer, the canvas antialiases shapes analytically without one
+    bool open(const string& title, uint32_t w, uint32_t h, bool fullscreen = false, int32_t samples = 0);
     void make_current();
     void swap();
     void close();
@@ -34,8 +38,14 @@ public:
     InputPtr get_input();
     SDL_Window* get_handle();
 
-    bool event_tick();
+    //with a wait_timeout (ms) the tick blocks until an event arrives, use it once
+    //Canvas::frame_changed() reported an idle frame and call skip_frame() instead of swap()
+    bool event_tick(int32_t wait_timeout = 0);
+    void request_redraw();
+    void skip_frame();
+    float get_idle_ratio();
 private:
+    bool handle_event(const SDL_Event& event);
     void initialise_sdl();
     void initialise_glad();
     void deinitialise_sdl();